@@ -0,0 +1,85 @@
+#!/bin/bash
+# Time record-heavy programs: merge.tig on two sorted lists of N numbers,
+# and a loop that builds lists and small arrays.  With BASE set to an
+# older compiler, its code (linked with the same runtime.c) is timed too.
+#   ./allocbench.sh            (N=n, ROUNDS=n, BASE=path/to/a.out)
+
+BIN=${BIN:-./a.out}
+TESTCASEDIR=./testcases
+N=${N:-50000}
+ROUNDS=${ROUNDS:-5}
+
+if [[ $BIN == ./a.out ]]; then
+	make >& /dev/null
+	if [[ $? != 0 ]]; then
+		echo "Compile Error"
+		exit 123
+	fi
+fi
+BIN=$(cd $(dirname $BIN) && pwd)/$(basename $BIN)
+[[ -n $BASE ]] && BASE=$(cd $(dirname $BASE) && pwd)/$(basename $BASE)
+RUNTIME=$(pwd)/runtime.c
+
+WORKDIR=$(mktemp -d)
+cp $TESTCASEDIR/merge.tig $WORKDIR
+cd $WORKDIR
+
+cat > lists.tig <<'EOF'
+let
+  type list = {head: int, tail: list}
+  type vec = array of int
+  function none(): list = nil
+  function build(n: int, t: list): list =
+    if n = 0 then t else build(n - 1, list{head = n, tail = t})
+  var total := 0
+in
+  for i := 1 to 2000 do
+    (let var l := build(1000, none())
+         var v := vec[8] of i
+     in total := total + l.head + v[7]
+     end);
+  printi(total); print("\n")
+end
+EOF
+
+awk -v n=$N 'BEGIN {
+	for (l = 0; l < 2; l++) {
+		for (i = 1; i <= n; i++) printf "%d ", 2 * i + l;
+		print l ? "b" : "a";
+	}
+}' > merge.in
+
+# build $2 with compiler $1 into $3
+build() {
+	$1 $2 >& /dev/null &&
+	gcc -Wl,--wrap,getchar -m32 $2.s $RUNTIME -o $3 >& /dev/null
+}
+
+# milliseconds per run of $1 on $2
+runTime() {
+	local start end i
+	start=$(date +%s%N)
+	for ((i = 0; i < ROUNDS; i++)); do
+		./$1 < $2 > /dev/null
+	done
+	end=$(date +%s%N)
+	awk "BEGIN { printf \"%.1f\", ($end - $start) / $ROUNDS / 1000000 }"
+}
+
+printf "%-12s %12s %12s\n" program "ms" "base ms"
+for prog in merge lists; do
+	input=/dev/null
+	[[ $prog == merge ]] && input=merge.in
+	if ! build $BIN $prog.tig $prog; then
+		echo "$prog: Compile Error"
+		continue
+	fi
+	time=$(runTime $prog $input)
+	base=-
+	if [[ -n $BASE ]] && build $BASE $prog.tig $prog.base; then
+		base=$(runTime $prog.base $input)
+	fi
+	printf "%-12s %12s %12s\n" $prog $time $base
+done
+cd - > /dev/null
+rm -rf $WORKDIR
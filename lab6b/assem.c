@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h> /* for atoi */
 #include <string.h> /* for strcpy */
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include "util.h"
 #include "symbol.h"
 #include "absyn.h"
@@ -21,28 +24,60 @@ AS_targets AS_Targets(Temp_labelList labels) {
    return p;
 }
 
-AS_instr AS_Oper(string a, Temp_tempList d, Temp_tempList s, AS_targets j) {
+AS_operand AS_None(void) {
+  AS_operand o;
+  o.kind = AS_NONE; o.dst = FALSE; o.index = 0; o.u.value = 0;
+  return o;
+}
+
+static AS_operand operand(int kind, bool dst, int index, int value) {
+  AS_operand o;
+  o.kind = kind; o.dst = dst; o.index = index; o.u.value = value;
+  return o;
+}
+
+AS_operand AS_Imm(int value) {return operand(AS_IMM, FALSE, 0, value);}
+AS_operand AS_Src(int index) {return operand(AS_TEMP, FALSE, index, 0);}
+AS_operand AS_Dst(int index) {return operand(AS_TEMP, TRUE, index, 0);}
+AS_operand AS_Addr(int index) {return operand(AS_ADDR, FALSE, index, 0);}
+AS_operand AS_Ind(int index) {return operand(AS_IND, FALSE, index, 0);}
+AS_operand AS_Disp(int value, int index) {return operand(AS_DISP, FALSE, index, value);}
+AS_operand AS_Abs(int value) {return operand(AS_ABS, FALSE, 0, value);}
+AS_operand AS_Target(int index) {return operand(AS_TARGET, FALSE, index, 0);}
+
+AS_operand AS_Name(Temp_label label) {
+  AS_operand o = AS_None();
+  o.kind = AS_NAME;
+  o.u.label = label;
+  return o;
+}
+
+AS_code AS_Code(AS_opcode op, AS_operand src, AS_operand dst) {
+  AS_code c;
+  c.op = op; c.src = src; c.dst = dst;
+  return c;
+}
+
+AS_instr AS_Oper(AS_code code, Temp_tempList d, Temp_tempList s, AS_targets j) {
   AS_instr p = (AS_instr) checked_malloc (sizeof *p);
   p->kind = I_OPER;
-  p->u.OPER.assem=a; 
+  p->u.OPER.code=code; 
   p->u.OPER.dst=d; 
   p->u.OPER.src=s; 
   p->u.OPER.jumps=j;
   return p;
 }
 
-AS_instr AS_Label(string a, Temp_label label) {
+AS_instr AS_Label(Temp_label label) {
   AS_instr p = (AS_instr) checked_malloc (sizeof *p);
   p->kind = I_LABEL;
-  p->u.LABEL.assem=a; 
   p->u.LABEL.label=label; 
   return p;
 }
 
-AS_instr AS_Move(string a, Temp_tempList d, Temp_tempList s) {
+AS_instr AS_Move(Temp_tempList d, Temp_tempList s) {
   AS_instr p = (AS_instr) checked_malloc (sizeof *p);
   p->kind = I_MOVE;
-  p->u.MOVE.assem=a; 
   p->u.MOVE.dst=d; 
   p->u.MOVE.src=s; 
   return p;
@@ -63,91 +98,265 @@ AS_instrList AS_splice(AS_instrList a, AS_instrList b) {
   return a;
 }
 	
-static Temp_temp nthTemp(Temp_tempList list, int i) {
-  assert(list);
-  if (i==0) return list->head;
-  else return nthTemp(list->tail,i-1);
+/* The text buffers keep their memory (from malloc, not a region) for as
+ * long as the thread that fills them. */
+static void *growText(void *p, size_t size)
+{
+ p = realloc(p, size);
+ if (!p) {
+   fprintf(stderr,"\nRan out of memory!\n");
+   exit(1);
+ }
+ return p;
 }
 
-static Temp_label nthLabel(Temp_labelList list, int i) {
-  assert(list);
-  if (i==0) return list->head;
-  else return nthLabel(list->tail,i-1);
+AS_buffer AS_Buffer(void)
+{AS_buffer b = growText(NULL, sizeof(*b));
+ b->size = 1 << 16;
+ b->text = growText(NULL, b->size);
+ b->length = 0;
+ return b;
 }
 
+void AS_bufferReset(AS_buffer b)
+{
+ b->length = 0;
+}
 
-/* first param is string created by this function by reading 'assem' string
- * and replacing `d `s and `j stuff.
- * Last param is function to use to determine what to do with each temp.
- */
-static void format(char *result, string assem, 
-		   Temp_tempList dst, Temp_tempList src,
-		   AS_targets jumps, Temp_map m)
+char *AS_reserve(AS_buffer b, size_t n)
 {
+ if (b->length + n > b->size) {
+   while (b->length + n > b->size) b->size *= 2;
+   b->text = growText(b->text, b->size);
+ }
+ return b->text + b->length;
+}
 
-  fprintf(stdout, "a format: assem=%s, dst=%p, src=%p\n", assem, dst, src);
-  char *p;
-  int i = 0; /* offset to result string */
-  for(p = assem; p && *p != '\0'; p++){
-    if (*p == '`') {
-      switch(*(++p)) {
-      case 's': {int n = atoi(++p);
-		 string s = Temp_look(m, nthTemp(src,n));
-		 strcpy(result+i, s);
-		 i += strlen(s);
-	       }
-	break;
-      case 'd': {int n = atoi(++p);
-		 string s = Temp_look(m, nthTemp(dst,n));
-     assert(s);
-		 strcpy(result+i, s);
-		 i += strlen(s);
-	       }
-	break;
-      case 'j': assert(jumps); 
-	       {int n = atoi(++p);
-		 string s = Temp_labelstring(nthLabel(jumps->labels,n));
-		 strcpy(result+i, s);
-		 i += strlen(s);
-	       }
-	break;
-      case '`': result[i] = '`'; i++; 
-	break;
-      default: assert(0);
-      }}
-    else {result[i] = *p; i++; }}
-  result[i] = '\0';
-  fprintf(stdout, "result=%s\n", result);
+void AS_write(AS_buffer b, const char *s, size_t n)
+{
+ memcpy(AS_reserve(b, n), s, n);
+ b->length += n;
 }
 
+void AS_puts(AS_buffer b, string s)
+{
+ AS_write(b, s, strlen(s));
+}
 
-void AS_print(FILE *out, AS_instr i, Temp_map m)
+/* Temp names by temp number.  A name is looked up in the Temp_map (down
+ * its layers) the first time a temp is met in a call of the emitter, and
+ * kept with its length until the next call. */
+struct name {string s; int length; unsigned epoch;};
+static __thread struct name *names = NULL;
+static __thread int nnames = 0;
+static __thread unsigned epoch = 0;
+
+static struct name *tempName(Temp_temp t, Temp_map m)
+{int n = getTempNum(t);
+ struct name *e;
+ if (n >= nnames) {
+   int old = nnames;
+   nnames = n + 1 > 2 * nnames ? n + 1 + 256 : 2 * nnames;
+   names = growText(names, nnames * sizeof(*names));
+   memset(names + old, 0, (nnames - old) * sizeof(*names));
+ }
+ e = &names[n];
+ if (e->epoch != epoch) {
+   e->s = Temp_look(m, t);
+   assert(e->s);
+   e->length = strlen(e->s);
+   e->epoch = epoch;
+ }
+ return e;
+}
+
+static string mnemonics[AS_OPCODES] = {
+  "", "movl", "addl", "subl", "imull", "idivl", "cltd", "cmp",
+  "pushl", "call", "jmp", "je", "jne", "jl", "jg", "jle", "jge",
+  "jb", "ja", "jbe", "jae",
+  "leave", "ret"
+};
+
+static void putName(AS_buffer b, Temp_tempList l, int index, Temp_map m)
 {
-  char r[200]; /* result */
-  switch (i->kind) {
-  case I_OPER:
-    format(r, i->u.OPER.assem, i->u.OPER.dst, i->u.OPER.src, i->u.OPER.jumps, m);
-    fprintf(out, "%s", r);
+  struct name *e;
+  for (; index > 0; index--) {assert(l); l = l->tail;}
+  assert(l);
+  e = tempName(l->head, m);
+  AS_write(b, e->s, e->length);
+}
+
+static void putInt(AS_buffer b, int value)
+{
+  char *p = AS_reserve(b, 12);
+  b->length += sprintf(p, "%d", value);
+}
+
+static void putOperand(AS_buffer b, AS_operand *o, Temp_tempList dst,
+                       Temp_tempList src, AS_targets jumps, Temp_map m)
+{
+  switch (o->kind) {
+  case AS_NONE:
     break;
-  case I_LABEL:
-    format(r, i->u.LABEL.assem, NULL, NULL, NULL, m); 
-    fprintf(out, "%s", r); 
-    /* i->u.LABEL->label); */
+  case AS_IMM:
+    AS_write(b, "$", 1);
+    putInt(b, o->u.value);
     break;
-  case I_MOVE:
-    format(r, i->u.MOVE.assem, i->u.MOVE.dst, i->u.MOVE.src, NULL, m);
-    fprintf(out, "%s", r);
+  case AS_TEMP:
+    putName(b, o->dst ? dst : src, o->index, m);
     break;
+  case AS_ADDR:
+    AS_write(b, "$", 1);
+    putName(b, src, o->index, m);
+    break;
+  case AS_DISP:
+    putInt(b, o->u.value);
+    /* fall through */
+  case AS_IND:
+    AS_write(b, "(", 1);
+    putName(b, src, o->index, m);
+    AS_write(b, ")", 1);
+    break;
+  case AS_ABS:
+    AS_write(b, "(", 1);
+    putInt(b, o->u.value);
+    AS_write(b, ")", 1);
+    break;
+  case AS_TARGET: {
+    Temp_labelList l;
+    int n = o->index;
+    assert(jumps);
+    for (l = jumps->labels; n > 0; n--) {assert(l); l = l->tail;}
+    assert(l);
+    AS_puts(b, Temp_labelstring(l->head));
+    break;
+  }
+  case AS_NAME:
+    AS_puts(b, Temp_labelstring(o->u.label));
+    break;
+  }
+}
+
+/* Append the text of i, without its newline, to b; m names the temps */
+static void format(AS_buffer b, AS_instr i, Temp_map m)
+{
+  AS_code *c;
+  switch (i->kind) {
+  case I_LABEL:
+    AS_puts(b, Temp_labelstring(i->u.LABEL.label));
+    AS_write(b, ":", 1);
+    return;
+  case I_MOVE:
+    AS_write(b, "movl ", 5);
+    putName(b, i->u.MOVE.src, 0, m);
+    AS_write(b, ", ", 2);
+    putName(b, i->u.MOVE.dst, 0, m);
+    return;
+  case I_OPER:
+    c = &i->u.OPER.code;
+    AS_puts(b, mnemonics[c->op]);
+    if (c->src.kind != AS_NONE) {
+      AS_write(b, " ", 1);
+      putOperand(b, &c->src, i->u.OPER.dst, i->u.OPER.src, i->u.OPER.jumps, m);
+    }
+    if (c->dst.kind != AS_NONE) {
+      AS_write(b, ", ", 2);
+      putOperand(b, &c->dst, i->u.OPER.dst, i->u.OPER.src, i->u.OPER.jumps, m);
+    }
+    return;
   }
 }
 
+static void emit(AS_buffer b, AS_instr i, Temp_map m)
+{
+  format(b, i, m);
+  if (i->kind != I_OPER || i->u.OPER.code.op != AS_NOP)
+    AS_write(b, "\n", 1);
+}
+
+void AS_emitInstrList(AS_buffer b, AS_instrList iList, Temp_map m)
+{
+  epoch++;
+  for (; iList; iList=iList->tail)
+    emit(b, iList->head, m);
+  AS_write(b, "\n", 1);
+}
+
+/* for debugging output, which is not worth a buffer of its own */
+static __thread AS_buffer scratch = NULL;
+
+void AS_print(FILE *out, AS_instr i, Temp_map m)
+{
+  if (!scratch) scratch = AS_Buffer();
+  AS_bufferReset(scratch);
+  epoch++;
+  emit(scratch, i, m);
+  fwrite(scratch->text, 1, scratch->length, out);
+}
+
+void AS_show(FILE *out, AS_instr i, Temp_map m)
+{
+  if (!scratch) scratch = AS_Buffer();
+  AS_bufferReset(scratch);
+  epoch++;
+  format(scratch, i, m);
+  fwrite(scratch->text, 1, scratch->length, out);
+}
+
 /* c should be COL_color; temporarily it is not */
 void AS_printInstrList (FILE *out, AS_instrList iList, Temp_map m)
 {
-  for (; iList; iList=iList->tail) {
-    AS_print(out, iList->head, m);
+  if (!scratch) scratch = AS_Buffer();
+  AS_bufferReset(scratch);
+  AS_emitInstrList(scratch, iList, m);
+  fwrite(scratch->text, 1, scratch->length, out);
+}
+
+bool AS_writePieces(int fd, AS_piece *pieces, int n, bool map)
+{
+  int i, k;
+  if (map) {
+    size_t total = 0, at = 0;
+    char *file;
+    for (i = 0; i < n; i++) total += pieces[i].length;
+    if (ftruncate(fd, total) < 0) return FALSE;
+    if (total == 0) return TRUE;
+    file = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) return FALSE;
+    for (i = 0; i < n; i++) {
+      memcpy(file + at, pieces[i].buffer->text + pieces[i].offset, pieces[i].length);
+      at += pieces[i].length;
+    }
+    return munmap(file, total) == 0;
+  }
+  for (i = 0; i < n; i += k) {
+    struct iovec iov[64];
+    size_t want = 0;
+    ssize_t done;
+    for (k = 0; k < 64 && i + k < n; k++) {
+      iov[k].iov_base = pieces[i+k].buffer->text + pieces[i+k].offset;
+      iov[k].iov_len = pieces[i+k].length;
+      want += iov[k].iov_len;
+    }
+    done = writev(fd, iov, k);
+    if (done < 0) return FALSE;
+    if ((size_t)done < want) {
+      /* short write: finish this batch one piece at a time */
+      int j;
+      for (j = 0; j < k; j++) {
+        char *p = iov[j].iov_base;
+        size_t len = iov[j].iov_len;
+        if ((size_t)done >= len) {done -= len; continue;}
+        p += done; len -= done; done = 0;
+        while (len > 0) {
+          ssize_t w = write(fd, p, len);
+          if (w < 0) return FALSE;
+          p += w; len -= w;
+        }
+      }
+    }
   }
-  fprintf(out, "\n");
+  return TRUE;
 }
 
 AS_proc AS_Proc(string p, AS_instrList b, string e)
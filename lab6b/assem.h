@@ -9,21 +9,69 @@
 typedef struct {Temp_labelList labels;} *AS_targets;
 AS_targets AS_Targets(Temp_labelList labels);
 
+/* An instruction is an x86 opcode with up to two operands, in AT&T
+ * order, and is only turned into text when it is printed.  Operands that
+ * are registers name one of the instruction's temps by its place in its
+ * dst or src list, so the register allocator can rename them.
+ * AS_NOP prints as nothing: it only makes its temps live. */
+typedef enum {
+  AS_NOP, AS_MOVL, AS_ADDL, AS_SUBL, AS_IMULL, AS_IDIVL, AS_CLTD, AS_CMP,
+  AS_PUSHL, AS_CALL, AS_JMP, AS_JE, AS_JNE, AS_JL, AS_JG, AS_JLE, AS_JGE,
+  AS_JB, AS_JA, AS_JBE, AS_JAE,
+  AS_LEAVE, AS_RET,
+  AS_OPCODES
+} AS_opcode;
+
+typedef struct {
+  enum {AS_NONE,
+        AS_IMM,        /* $value */
+        AS_TEMP,       /* `d<index> or `s<index> */
+        AS_ADDR,       /* $`s<index>, a temp named by a label */
+        AS_IND,        /* (`s<index>) */
+        AS_DISP,       /* value(`s<index>) */
+        AS_ABS,        /* (value) */
+        AS_TARGET,     /* jump target <index> */
+        AS_NAME        /* label */
+  } kind;
+  bool dst;            /* AS_TEMP: the temp is in dst, not src */
+  int index;
+  union {int value; Temp_label label;} u;
+} AS_operand;
+
+typedef struct {AS_opcode op; AS_operand src, dst;} AS_code;
+
+AS_operand AS_None(void);
+AS_operand AS_Imm(int value);
+AS_operand AS_Src(int index);
+AS_operand AS_Dst(int index);
+AS_operand AS_Addr(int index);
+AS_operand AS_Ind(int index);
+AS_operand AS_Disp(int value, int index);
+AS_operand AS_Abs(int value);
+AS_operand AS_Target(int index);
+AS_operand AS_Name(Temp_label label);
+
+/* op src, dst; a one-operand instruction has only src */
+AS_code AS_Code(AS_opcode op, AS_operand src, AS_operand dst);
+
 typedef struct AS_instr_ *AS_instr;
 struct AS_instr_ { enum {I_OPER, I_LABEL, I_MOVE} kind;
-	       union {struct {string assem; Temp_tempList dst, src; 
+	       union {struct {AS_code code; Temp_tempList dst, src; 
 			      AS_targets jumps;} OPER;
-		      struct {string assem; Temp_label label;} LABEL;
-		      struct {string assem; Temp_tempList dst, src;} MOVE;
+		      struct {Temp_label label;} LABEL;
+		      struct {Temp_tempList dst, src;} MOVE;  /* movl `s0, `d0 */
 		    } u;
 	      };
 
-AS_instr AS_Oper(string a, Temp_tempList d, Temp_tempList s, AS_targets j);
-AS_instr AS_Label(string a, Temp_label label);
-AS_instr AS_Move(string a, Temp_tempList d, Temp_tempList s);
+AS_instr AS_Oper(AS_code code, Temp_tempList d, Temp_tempList s, AS_targets j);
+AS_instr AS_Label(Temp_label label);
+AS_instr AS_Move(Temp_tempList d, Temp_tempList s);
 
 void AS_print(FILE *out, AS_instr i, Temp_map m);
 
+/* AS_print without the newline, for traces */
+void AS_show(FILE *out, AS_instr i, Temp_map m);
+
 typedef struct AS_instrList_ *AS_instrList;
 struct AS_instrList_ { AS_instr head; AS_instrList tail;};
 AS_instrList AS_InstrList(AS_instr head, AS_instrList tail);
@@ -40,5 +88,28 @@ struct AS_proc_ {
 
 AS_proc AS_Proc(string p, AS_instrList b, string e);
 
+/* A growable text buffer that keeps its memory from one use to the next,
+ * so emitting into it allocates nothing once it is big enough */
+typedef struct AS_buffer_ *AS_buffer;
+struct AS_buffer_ {char *text; size_t length, size;};
+
+AS_buffer AS_Buffer(void);
+void AS_bufferReset(AS_buffer b);          /* empty, keeping the memory */
+char *AS_reserve(AS_buffer b, size_t n);   /* room for n more bytes at
+                                              text+length */
+void AS_write(AS_buffer b, const char *s, size_t n);
+void AS_puts(AS_buffer b, string s);
+
+/* Append the instructions, and a newline, to "b" (as AS_printInstrList
+ * prints them).  Each temp's name is looked up in "m" once per call. */
+void AS_emitInstrList(AS_buffer b, AS_instrList iList, Temp_map m);
+
+/* Part of a buffer's text; the offset stays good as the buffer grows */
+typedef struct {AS_buffer buffer; size_t offset, length;} AS_piece;
+
+/* Write the pieces in order to the file "fd": with writev, or if "map" by
+ * copying them into the file mapped in memory.  FALSE on an error. */
+bool AS_writePieces(int fd, AS_piece *pieces, int n, bool map);
+
 
 #endif
@@ -0,0 +1,95 @@
+/*
+ * bitset.c - Word-packed sets of small integers.
+ */
+
+#include <string.h>
+#include "util.h"
+#include "bitset.h"
+
+Bit_set Bit_Set(int size)
+{Bit_set s = checked_malloc(sizeof(*s));
+ assert(size >= 0);
+ s->size = size;
+ s->nwords = (size + BIT_WORDBITS - 1) / BIT_WORDBITS;
+ s->words = checked_malloc(s->nwords * sizeof(Bit_word));
+ memset(s->words, 0, s->nwords * sizeof(Bit_word));
+ return s;
+}
+
+void Bit_add(Bit_set s, int i)
+{
+ assert(i >= 0 && i < s->size);
+ s->words[i / BIT_WORDBITS] |= (Bit_word)1 << (i % BIT_WORDBITS);
+}
+
+void Bit_remove(Bit_set s, int i)
+{
+ assert(i >= 0 && i < s->size);
+ s->words[i / BIT_WORDBITS] &= ~((Bit_word)1 << (i % BIT_WORDBITS));
+}
+
+bool Bit_member(Bit_set s, int i)
+{
+ assert(i >= 0 && i < s->size);
+ return (s->words[i / BIT_WORDBITS] >> (i % BIT_WORDBITS)) & 1;
+}
+
+void Bit_clear(Bit_set s)
+{
+ memset(s->words, 0, s->nwords * sizeof(Bit_word));
+}
+
+void Bit_copy(Bit_set s, Bit_set t)
+{
+ assert(s->size == t->size);
+ memcpy(s->words, t->words, s->nwords * sizeof(Bit_word));
+}
+
+bool Bit_union(Bit_set s, Bit_set t)
+{Bit_word *restrict a = s->words;
+ const Bit_word *restrict b = t->words;
+ Bit_word changed = 0;
+ int i, n = s->nwords;
+ assert(s->size == t->size);
+ for (i = 0; i < n; i++) {
+   Bit_word w = a[i] | b[i];
+   changed |= w ^ a[i];
+   a[i] = w;
+ }
+ return changed != 0;
+}
+
+void Bit_diff(Bit_set s, Bit_set t)
+{Bit_word *restrict a = s->words;
+ const Bit_word *restrict b = t->words;
+ int i, n = s->nwords;
+ assert(s->size == t->size);
+ for (i = 0; i < n; i++)
+   a[i] &= ~b[i];
+}
+
+bool Bit_equal(Bit_set s, Bit_set t)
+{
+ assert(s->size == t->size);
+ return memcmp(s->words, t->words, s->nwords * sizeof(Bit_word)) == 0;
+}
+
+int Bit_count(Bit_set s)
+{int i, n = 0;
+ for (i = 0; i < s->nwords; i++)
+   n += __builtin_popcountl(s->words[i]);
+ return n;
+}
+
+int Bit_next(Bit_set s, int i)
+{int w;
+ Bit_word bits;
+ if (i >= s->size) return -1;
+ w = i / BIT_WORDBITS;
+ bits = s->words[w] & (~(Bit_word)0 << (i % BIT_WORDBITS));
+ while (!bits) {
+   if (++w >= s->nwords) return -1;
+   bits = s->words[w];
+ }
+ return w * BIT_WORDBITS + __builtin_ctzl(bits);
+}
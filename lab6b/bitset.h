@@ -0,0 +1,51 @@
+#ifndef BITSET_H
+#define BITSET_H
+/*
+ * bitset.h - Fixed-size sets of small integers packed into machine words.
+ *
+ * Every set operation works a word at a time over plain arrays, so the
+ * compiler can vectorize the loops.  Binary operations require both
+ * sets to have the same size and update their first argument in place.
+ */
+
+typedef unsigned long Bit_word;
+#define BIT_WORDBITS ((int)(8 * sizeof(Bit_word)))
+
+typedef struct Bit_set_ *Bit_set;
+struct Bit_set_ {
+    int size;               /* members are 0..size-1 */
+    int nwords;
+    Bit_word *words;
+};
+
+/* Make an empty set able to hold 0..size-1 */
+Bit_set Bit_Set(int size);
+
+/* Add, remove and test for a single member */
+void Bit_add(Bit_set s, int i);
+void Bit_remove(Bit_set s, int i);
+bool Bit_member(Bit_set s, int i);
+
+/* Remove every member */
+void Bit_clear(Bit_set s);
+
+/* s = t */
+void Bit_copy(Bit_set s, Bit_set t);
+
+/* s = s union t; return TRUE if s changed */
+bool Bit_union(Bit_set s, Bit_set t);
+
+/* s = s - t */
+void Bit_diff(Bit_set s, Bit_set t);
+
+/* TRUE if s and t have the same members */
+bool Bit_equal(Bit_set s, Bit_set t);
+
+/* Number of members */
+int Bit_count(Bit_set s);
+
+/* The smallest member >= i, or -1 if there is none.  Iterate with
+ *   for (i = Bit_next(s, 0); i >= 0; i = Bit_next(s, i + 1)) ... */
+int Bit_next(Bit_set s, int i);
+
+#endif
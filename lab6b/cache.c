@@ -0,0 +1,416 @@
+/*
+ * cache.c - On-disk cache of compiled functions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "symbol.h"
+#include "table.h"
+#include "temp.h"
+#include "tree.h"
+#include "assem.h"
+#include "frame.h"
+#include "cache.h"
+
+#define MAGIC "tiger-cache 1"
+#define MARK '\001'             /* brackets a canonical label number */
+
+/* 128 bits, from two 64-bit hashes fed the same words */
+struct hash {unsigned long long a, b;};
+
+static void mix(struct hash *h, unsigned long long v)
+{
+ h->a = (h->a ^ v) * 0x100000001b3ULL;
+ h->b = (h->b + v) * 0x9E3779B97F4A7C15ULL;
+ h->b ^= h->b >> 29;
+}
+
+static void mixString(struct hash *h, string s)
+{
+ mix(h, strlen(s));
+ for (; *s; s++) mix(h, (unsigned char)*s);
+}
+
+static string dir = NULL;
+static long maxBytes;
+static struct hash base;        /* the compiler binary and its options */
+
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static long total;              /* bytes in the directory, under cacheLock */
+static long hits, misses, stores, evictions;
+
+bool CA_open(string d, long max, string options)
+{struct stat st;
+ if (mkdir(d, 0777) < 0 && errno != EEXIST) return FALSE;
+ if (stat(d, &st) < 0 || !S_ISDIR(st.st_mode) || access(d, W_OK) < 0)
+   return FALSE;
+ dir = d;
+ maxBytes = max;
+ base.a = 0xcbf29ce484222325ULL;
+ base.b = 0;
+ mixString(&base, MAGIC);
+ mixString(&base, options);
+ // a rebuilt compiler may emit different code
+ if (stat("/proc/self/exe", &st) == 0) {
+   mix(&base, st.st_size);
+   mix(&base, st.st_mtime);
+ }
+ total = -1;
+ return TRUE;
+}
+
+bool CA_enabled(void)
+{
+ return dir != NULL;
+}
+
+
+/* The front end's labels (Ln) are numbered across the whole program;
+ * named labels and those of Temp_function ("f.Ln") are not. */
+static bool programLabel(Temp_label l)
+{string s = S_name(l);
+ if (s[0] != 'L' || !s[1]) return FALSE;
+ for (s++; *s; s++)
+   if (!isdigit((unsigned char)*s)) return FALSE;
+ return TRUE;
+}
+
+struct CA_key_ {
+  char name[33];                /* the hash in hex */
+  Temp_map regs;                /* the machine registers, hashed by name */
+  int *temps, ntemps, maxtemps; /* the other temps' numbers, sorted */
+  TAB_table numbers;            /* program label -> canonical number + 1 */
+  Temp_label *labels;           /* canonical number -> program label */
+  int nlabels, maxlabels;
+};
+
+/* The key is made in two walks of the statements: the first (h NULL)
+ * collects the temps and program labels, the second hashes them by
+ * their canonical numbers. */
+static void temp(CA_key k, Temp_temp t, struct hash *h)
+{string reg = Temp_look(k->regs, t);
+ int lo, hi, n = getTempNum(t);
+ if (reg) {
+   if (h) {mix(h, 'R'); mixString(h, reg);}
+   return;
+ }
+ if (!h) {
+   if (k->ntemps == k->maxtemps) {
+     int *old = k->temps;
+     k->maxtemps = k->maxtemps ? 2 * k->maxtemps : 64;
+     k->temps = checked_malloc(k->maxtemps * sizeof(int));
+     if (k->ntemps) memcpy(k->temps, old, k->ntemps * sizeof(int));
+   }
+   k->temps[k->ntemps++] = n;
+   return;
+ }
+ // the rank among the function's temps, so their order is kept
+ for (lo = 0, hi = k->ntemps; lo < hi; ) {
+   int mid = (lo + hi) / 2;
+   if (k->temps[mid] < n) lo = mid + 1; else hi = mid;
+ }
+ mix(h, 'T');
+ mix(h, lo);
+}
+
+static void label(CA_key k, Temp_label l, struct hash *h)
+{int n;
+ if (!programLabel(l)) {
+   if (h) {mix(h, 'N'); mixString(h, S_name(l));}
+   return;
+ }
+ n = (int)(long)TAB_look(k->numbers, l);
+ if (h) {
+   mix(h, 'L');
+   mix(h, n);
+   return;
+ }
+ if (n) return;
+ if (k->nlabels == k->maxlabels) {
+   Temp_label *old = k->labels;
+   k->maxlabels = k->maxlabels ? 2 * k->maxlabels : 16;
+   k->labels = checked_malloc(k->maxlabels * sizeof(Temp_label));
+   if (k->nlabels) memcpy(k->labels, old, k->nlabels * sizeof(Temp_label));
+ }
+ k->labels[k->nlabels++] = l;
+ TAB_enter(k->numbers, l, (void *)(long)k->nlabels);
+}
+
+static void walkExp(CA_key k, T_exp e, struct hash *h);
+
+static void walkStm(CA_key k, T_stm s, struct hash *h)
+{Temp_labelList l;
+ if (h) mix(h, s->kind);
+ switch (s->kind) {
+ case T_SEQ:
+   walkStm(k, s->u.SEQ.left, h);
+   walkStm(k, s->u.SEQ.right, h);
+   break;
+ case T_LABEL:
+   label(k, s->u.LABEL, h);
+   break;
+ case T_JUMP:
+   walkExp(k, s->u.JUMP.exp, h);
+   for (l = s->u.JUMP.jumps; l; l = l->tail)
+     label(k, l->head, h);
+   break;
+ case T_CJUMP:
+   if (h) mix(h, s->u.CJUMP.op);
+   walkExp(k, s->u.CJUMP.left, h);
+   walkExp(k, s->u.CJUMP.right, h);
+   label(k, s->u.CJUMP.true, h);
+   label(k, s->u.CJUMP.false, h);
+   break;
+ case T_MOVE:
+   walkExp(k, s->u.MOVE.dst, h);
+   walkExp(k, s->u.MOVE.src, h);
+   break;
+ case T_EXP:
+   walkExp(k, s->u.EXP, h);
+   break;
+ }
+}
+
+static void walkExp(CA_key k, T_exp e, struct hash *h)
+{T_expList l;
+ if (h) mix(h, 100 + e->kind);
+ switch (e->kind) {
+ case T_BINOP:
+   if (h) mix(h, e->u.BINOP.op);
+   walkExp(k, e->u.BINOP.left, h);
+   walkExp(k, e->u.BINOP.right, h);
+   break;
+ case T_MEM:
+   walkExp(k, e->u.MEM, h);
+   break;
+ case T_TEMP:
+   temp(k, e->u.TEMP, h);
+   break;
+ case T_ESEQ:
+   walkStm(k, e->u.ESEQ.stm, h);
+   walkExp(k, e->u.ESEQ.exp, h);
+   break;
+ case T_NAME:
+   label(k, e->u.NAME, h);
+   break;
+ case T_CONST:
+   if (h) mix(h, (unsigned)e->u.CONST);
+   break;
+ case T_CALL:
+   walkExp(k, e->u.CALL.fun, h);
+   for (l = e->u.CALL.args; l; l = l->tail)
+     walkExp(k, l->head, h);
+   if (h) mix(h, 'E');
+   break;
+ }
+}
+
+static int compareInts(const void *a, const void *b)
+{int x = *(const int *)a, y = *(const int *)b;
+ return x < y ? -1 : x > y;
+}
+
+CA_key CA_procKey(F_frame frame, T_stmList stms)
+{CA_key k = checked_malloc(sizeof(*k));
+ struct hash h = base;
+ T_stmList l;
+ int i, n;
+
+ k->regs = F_preColored();
+ k->temps = NULL;
+ k->ntemps = k->maxtemps = 0;
+ k->numbers = TAB_empty();
+ k->labels = NULL;
+ k->nlabels = k->maxlabels = 0;
+
+ for (l = stms; l; l = l->tail)
+   walkStm(k, l->head, NULL);
+ qsort(k->temps, k->ntemps, sizeof(int), compareInts);
+ for (i = n = 0; i < k->ntemps; i++)
+   if (n == 0 || k->temps[n-1] != k->temps[i])
+     k->temps[n++] = k->temps[i];
+ k->ntemps = n;
+
+ mixString(&h, S_name(F_name(frame)));
+ mix(&h, (unsigned)F_frameMaxOffset(frame));
+ /* -fgc: which slots the map lists follows the variables' types, which
+  * the trees do not show; the spills that come later follow the trees */
+ if (F_gc) mixString(&h, F_frameMap(frame));
+ for (l = stms; l; l = l->tail)
+   walkStm(k, l->head, &h);
+ snprintf(k->name, sizeof(k->name), "%016llx%016llx", h.a, h.b);
+ return k;
+}
+
+
+static void entryPath(char *path, size_t size, CA_key key)
+{
+ snprintf(path, size, "%s/%s", dir, key->name);
+}
+
+/* the whole of the file "path" in a malloc'd buffer, or NULL */
+static char *readFile(string path, size_t *length)
+{FILE *in = fopen(path, "rb");
+ struct stat st;
+ char *text;
+ if (!in) return NULL;
+ if (fstat(fileno(in), &st) < 0 || !(text = malloc(st.st_size + 1))) {
+   fclose(in);
+   return NULL;
+ }
+ *length = fread(text, 1, st.st_size, in);
+ text[*length] = '\0';
+ fclose(in);
+ return text;
+}
+
+/* Expand the entry "text" for "key" into "out", if every label number in
+ * it is one of the key's; FALSE (adding nothing) if not. */
+static bool expand(CA_key key, char *text, size_t length, AS_buffer out)
+{char *p, *end = text + length, *body;
+ int pass;
+ if (length < sizeof(MAGIC) || memcmp(text, MAGIC "\n", sizeof(MAGIC)) != 0)
+   return FALSE;
+ body = text + sizeof(MAGIC);
+ for (pass = 0; pass < 2; pass++)
+   for (p = body; p < end; ) {
+     char *mark = memchr(p, MARK, end - p), *close;
+     int n;
+     if (!mark) mark = end;
+     if (pass) AS_write(out, p, mark - p);
+     if (mark == end) break;
+     close = memchr(mark + 1, MARK, end - mark - 1);
+     n = atoi(mark + 1);
+     if (!close || n < 1 || n > key->nlabels) return FALSE;
+     if (pass) AS_puts(out, S_name(key->labels[n-1]));
+     p = close + 1;
+   }
+ return TRUE;
+}
+
+bool CA_fetch(CA_key key, AS_buffer out)
+{char path[1024];
+ size_t length;
+ char *text;
+ bool hit;
+ entryPath(path, sizeof(path), key);
+ text = readFile(path, &length);
+ hit = text && expand(key, text, length, out);
+ free(text);
+ if (hit) utimensat(AT_FDCWD, path, NULL, 0);   // now most recently used
+ __atomic_fetch_add(hit ? &hits : &misses, 1, __ATOMIC_RELAXED);
+ return hit;
+}
+
+
+struct entry {char name[33]; long size; struct timespec used;};
+
+static int olderFirst(const void *a, const void *b)
+{const struct entry *x = a, *y = b;
+ if (x->used.tv_sec != y->used.tv_sec)
+   return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+ return x->used.tv_nsec < y->used.tv_nsec ? -1 : x->used.tv_nsec > y->used.tv_nsec;
+}
+
+/* Total up the directory, which other compilers may share; if it is over
+ * the bound, remove the least recently used entries down to 3/4 of it.
+ * Called with cacheLock held. */
+static void evict(void)
+{DIR *d = opendir(dir);
+ struct dirent *de;
+ struct entry *entries = NULL;
+ int n = 0, max = 0, i;
+ char path[1024];
+ struct stat st;
+ if (!d) return;
+ total = 0;
+ while ((de = readdir(d))) {
+   if (strlen(de->d_name) != 32) continue;       // not an entry
+   snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+   if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+   if (n == max) {
+     max = max ? 2 * max : 256;
+     entries = realloc(entries, max * sizeof(*entries));
+     if (!entries) break;
+   }
+   strcpy(entries[n].name, de->d_name);
+   entries[n].size = st.st_size;
+   entries[n].used = st.st_mtim;
+   total += st.st_size;
+   n++;
+ }
+ closedir(d);
+ if (entries && total > maxBytes) {
+   qsort(entries, n, sizeof(*entries), olderFirst);
+   for (i = 0; i < n && total > maxBytes / 4 * 3; i++) {
+     snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+     if (unlink(path) == 0) {
+       total -= entries[i].size;
+       evictions++;
+     }
+   }
+ }
+ free(entries);
+}
+
+void CA_store(CA_key key, char *text, size_t length)
+{char path[1024], tmp[1100];
+ static int tmps = 0;
+ FILE *out;
+ long size;
+ size_t i, j;
+
+ entryPath(path, sizeof(path), key);
+ snprintf(tmp, sizeof(tmp), "%s/.tmp.%d.%d", dir, (int)getpid(),
+          __atomic_fetch_add(&tmps, 1, __ATOMIC_RELAXED));
+ if (!(out = fopen(tmp, "wb"))) return;
+ fputs(MAGIC "\n", out);
+ // replace each program label in the text by its canonical number
+ for (i = 0; i < length; i = j) {
+   for (j = i; j < length && (isalnum((unsigned char)text[j])
+                              || text[j] == '_' || text[j] == '.'); j++) ;
+   if (j == i) {
+     putc(text[j++], out);
+     continue;
+   }
+   if (text[i] == 'L' && j - i > 1 && j - i < 16) {
+     char name[16];
+     int n;
+     memcpy(name, text + i, j - i);
+     name[j - i] = '\0';
+     if (programLabel(S_Symbol(name))
+         && (n = (int)(long)TAB_look(key->numbers, S_Symbol(name)))) {
+       fprintf(out, "%c%d%c", MARK, n, MARK);
+       continue;
+     }
+   }
+   fwrite(text + i, 1, j - i, out);
+ }
+ size = ftell(out);
+ if (fclose(out) != 0 || rename(tmp, path) != 0) {
+   unlink(tmp);
+   return;
+ }
+ pthread_mutex_lock(&cacheLock);
+ stores++;
+ if (total < 0) evict();
+ else if ((total += size) > maxBytes) evict();
+ pthread_mutex_unlock(&cacheLock);
+}
+
+void CA_report(FILE *out)
+{long lookups = hits + misses;
+ fprintf(out, "compile cache %s: %ld hits, %ld misses (%.1f%% hit), "
+              "%ld stored, %ld evicted\n",
+         dir, hits, misses, lookups ? 100.0 * hits / lookups : 0.0,
+         stores, evictions);
+}
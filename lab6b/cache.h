@@ -0,0 +1,41 @@
+#ifndef CACHE_H
+#define CACHE_H
+/*
+ * cache.h - On-disk cache of compiled functions, for -fcache.
+ *
+ * A function fragment's key is a hash of its frame (under -fgc, its
+ * map of the slots that may hold pointers too) and of its statements
+ * after trace scheduling, together with the compiler binary and the
+ * options that change code.  The key renumbers the front end's temps and
+ * labels, keeping their order, so that an edit to one function does not
+ * miss the cache for the others; a cached entry is the function's final
+ * assembly with those labels replaced by their canonical numbers.
+ *
+ * Each entry is a file in the cache directory named by its key.  A hit
+ * touches the file, and when the directory outgrows its bound the least
+ * recently used entries are removed.
+ */
+
+typedef struct CA_key_ *CA_key;
+
+/* Cache in the directory "dir" (made if need be), up to "maxBytes" of
+ * entries; "options" names the choices that change the code produced.
+ * FALSE if the directory cannot be used. */
+bool CA_open(string dir, long maxBytes, string options);
+
+/* TRUE if CA_open succeeded */
+bool CA_enabled(void);
+
+/* The key of the function "frame" with body "stms" */
+CA_key CA_procKey(F_frame frame, T_stmList stms);
+
+/* Append the entry for "key" to "out"; FALSE on a miss */
+bool CA_fetch(CA_key key, AS_buffer out);
+
+/* Record "text" (length bytes) as the entry for "key" */
+void CA_store(CA_key key, char *text, size_t length);
+
+/* Print the hits, misses and evictions so far */
+void CA_report(FILE *out);
+
+#endif
@@ -0,0 +1,74 @@
+#!/bin/bash
+# Check that -fcache gives the code a compile without it gives, for edits
+# that leave a function's trees alone but change what it must tell the
+# compiler: under -fgc, a variable whose type goes from int to a record
+# (its slot joins the frame's map of pointers).  Each case compiles the
+# first version into an empty cache, then the second with that cache.
+#   ./cachetest.sh
+
+BIN=${BIN:-./a.out}
+
+if [[ $BIN == ./a.out ]]; then
+	make >& /dev/null
+	if [[ $? != 0 ]]; then
+		echo "Compile Error"
+		exit 123
+	fi
+fi
+BIN=$(cd $(dirname $BIN) && pwd)/$(basename $BIN)
+
+WORKDIR=$(mktemp -d)
+cd $WORKDIR
+
+# f's trees are the same either way: x is set from a call of zero
+cat > scalar.tig <<'EOF'
+let
+  type list = {head: int, tail: list}
+  function zero(): int = 0
+  function f(n: int): int =
+    let var x := zero()
+        function g() = x := n
+        function h(): int = x
+    in g(); h()
+    end
+in printi(f(7))
+end
+EOF
+cat > pointer.tig <<'EOF'
+let
+  type list = {head: int, tail: list}
+  function zero(): list = nil
+  function f(n: int): int =
+    let var x := zero()
+        function g() = x := list{head = n, tail = nil}
+        function h(): int = (list{head = 0, tail = nil}; x.head)
+    in g(); h()
+    end
+in printi(f(7))
+end
+EOF
+
+failed=0
+# compile $2 after $1 with flags $3, into one cache
+check() {
+	rm -rf cache cached.s
+	cp $1.tig t.tig
+	$BIN $3 -fcache=cache t.tig >& /dev/null
+	cp $2.tig t.tig
+	$BIN $3 -fcache=cache t.tig >& /dev/null && mv t.tig.s cached.s
+	$BIN $3 t.tig >& /dev/null
+	if cmp -s cached.s t.tig.s; then
+		echo "$1 -> $2 $3: ok"
+	else
+		echo "$1 -> $2 $3: cached code differs"
+		failed=1
+	fi
+}
+
+check scalar pointer -fgc
+check pointer scalar -fgc
+check scalar pointer ""
+
+cd - > /dev/null
+rm -rf $WORKDIR
+exit $failed
@@ -217,8 +217,8 @@ struct C_block C_basicBlocks(T_stmList stmList)
   return b;
 }
 
-static S_table block_env;
-static struct C_block global_block;
+static __thread S_table block_env;
+static __thread struct C_block global_block;
 
 static T_stmList getLast(T_stmList list)
 {
@@ -0,0 +1,109 @@
+/*
+ * client.c - Thin client for the compile server (a.out -fserver), usable
+ *            wherever a.out is, e.g. BIN=tiger-client in gradeMe.sh:
+ *
+ *   tiger-client [-s socket] file.tig    compile file.tig to file.tig.s
+ *   tiger-client [-s socket] -           compile standard input, writing
+ *                                        the assembly to standard output
+ *   tiger-client [-s socket] -shutdown   stop the server
+ *
+ *            Error messages go to stderr and the exit status is a.out's.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "util.h"
+#include "server.h"
+
+static FILE *connectTo(string path)
+{struct sockaddr_un addr;
+ int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+ memset(&addr, 0, sizeof(addr));
+ addr.sun_family = AF_UNIX;
+ strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+ if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+   fprintf(stderr, "tiger-client: no compile server on %s\n", path);
+   exit(2);
+ }
+ return fdopen(fd, "r+");
+}
+
+/* the whole of "in", in a malloc'd buffer */
+static char *readAll(FILE *in, size_t *length)
+{size_t size = 65536, n;
+ char *text = malloc(size);
+ *length = 0;
+ while (text && (n = fread(text + *length, 1, size - *length, in)) > 0)
+   if ((*length += n) == size)
+     text = realloc(text, size *= 2);
+ if (!text) {
+   fprintf(stderr, "tiger-client: out of memory\n");
+   exit(2);
+ }
+ return text;
+}
+
+/* copy the reply's frames to stdout and stderr; the server's exit status */
+static int reply(FILE *conn)
+{char kind[8], buf[4096];
+ unsigned long length;
+ while (fscanf(conn, "%7s %lu", kind, &length) == 2 && fgetc(conn) == '\n') {
+   FILE *to;
+   if (strcmp(kind, "EXIT") == 0) return (int)length;
+   to = strcmp(kind, "ASM") == 0 ? stdout : stderr;
+   while (length > 0) {
+     size_t n = fread(buf, 1, length < sizeof(buf) ? length : sizeof(buf), conn);
+     if (n == 0) break;
+     fwrite(buf, 1, n, to);
+     length -= n;
+   }
+ }
+ fprintf(stderr, "tiger-client: the compile server hung up\n");
+ return 2;
+}
+
+int main(int argc, string *argv)
+{string path = SV_defaultSocket(), file = NULL;
+ char full[PATH_MAX];
+ FILE *conn;
+ int i;
+
+ for (i = 1; i < argc; i++) {
+   if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+     path = argv[++i];
+   else if (file == NULL)
+     file = argv[i];
+   else
+     file = "";
+ }
+ if (file == NULL || *file == '\0') {
+   fprintf(stderr, "usage: tiger-client [-s socket] file.tig | - | -shutdown\n");
+   return 1;
+ }
+
+ conn = connectTo(path);
+ if (strcmp(file, "-shutdown") == 0)
+   fprintf(conn, "SHUTDOWN\n");
+ else if (strcmp(file, "-") == 0) {
+   size_t length;
+   char *text = readAll(stdin, &length);
+   fprintf(conn, "SOURCE %lu <stdin>\n", (unsigned long)length);
+   fwrite(text, 1, length, conn);
+   free(text);
+ }
+ else {
+   // the server has its own working directory
+   if (!realpath(file, full)) {
+     fprintf(stderr, "%s:cannot open\n", file);
+     return 1;
+   }
+   fprintf(conn, "COMPILE %s\n", full);
+ }
+ fflush(conn);
+ return reply(conn);
+}
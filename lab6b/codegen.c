@@ -22,7 +22,7 @@ static Temp_temp munchMemExp(T_exp e);
 static Temp_temp munchOpExp(T_exp e);
 
 
-static AS_instrList iList = NULL, last = NULL;
+static __thread AS_instrList iList = NULL, last = NULL;
 static void emit(AS_instr inst) {
 	if(last != NULL) {
 		last = last->tail = AS_InstrList(inst, NULL);
@@ -49,7 +49,7 @@ static Temp_temp munchExp(T_exp e) {
 		case T_BINOP:
 			return munchOpExp(e);
 		case T_CONST: {
-			emit(AS_Oper(createString("movl $%d, `d0\n", e->u.CONST), L(r, NULL), NULL, NULL));
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Imm(e->u.CONST), AS_Dst(0)), L(r, NULL), NULL, NULL));
 			// emit(AS_Oper(createString("ADDI `d0 <- r0+%d\n", e->u.CONST), L(r, NULL), NULL, NULL));
 			return r;
 		}
@@ -64,13 +64,16 @@ static Temp_temp munchExp(T_exp e) {
 			break;
 		}
 		case T_CALL: {
+			Temp_tempList args;
 			r = F_RV();
-			printf("??%d\n", e->u.CALL.fun->kind);
 			assert(e->u.CALL.fun->kind == T_NAME);
-			char buf[100];
-			sprintf(buf, "call %s\n", S_name(e->u.CALL.fun->u.NAME));
-			emit(AS_Oper(String(buf), 
-				F_callerSaves(), munchArgs(0, e->u.CALL.args), NULL));
+			args = munchArgs(0, e->u.CALL.args);
+			// -fgc: the collector starts from this frame
+			if(F_gc && F_allocates(e->u.CALL.fun->u.NAME))
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Name(Temp_namedlabel("tiger_frame"))),
+					NULL, L(F_FP(), NULL), NULL));
+			emit(AS_Oper(AS_Code(AS_CALL, AS_Name(e->u.CALL.fun->u.NAME), AS_None()), 
+				F_gc ? F_registers() : F_callerSaves(), args, NULL));
 			// emit(AS_Oper(String("call `s0\n"), 
 			// 	F_callerSaves(), L(munchExp(e->u.CALL.fun), munchArgs(0, e->u.CALL.args)), NULL));
     		break;
@@ -88,55 +91,66 @@ static void munchStm(T_stm s) {
 			munchMoveStm(s);
 			break;
 		case T_LABEL: {
-			char buf[100];
-			sprintf(buf, "%s:\n", Temp_labelstring(s->u.LABEL));
-			emit(AS_Label(String(buf), s->u.LABEL));
+			emit(AS_Label(s->u.LABEL));
 			break;
 		}
 		case T_JUMP: {
-			emit(AS_Oper(String("jmp `j0\n"), NULL, NULL, AS_Targets(s->u.JUMP.jumps)));
+			emit(AS_Oper(AS_Code(AS_JMP, AS_Target(0), AS_None()), NULL, NULL, AS_Targets(s->u.JUMP.jumps)));
 			// emit(AS_Oper(String("jmp `j0\n"), 
 			// 	L(munchExp(s->u.JUMP.exp), NULL), NULL, AS_Targets(s->u.JUMP.jumps)));
 			break;
 		} 
 		case T_CJUMP: {
-			string jump;
+			AS_opcode jump;
 			if(s->u.CJUMP.left->kind == T_NAME || s->u.CJUMP.right->kind == T_NAME) {
 				if(s->u.CJUMP.left->kind == T_NAME) {
-					emit(AS_Oper(String("pushl `s0\n"), NULL, L(munchExp(s->u.CJUMP.right), NULL), NULL));
-					emit(AS_Oper(String("pushl $`s0\n"), NULL, L(munchExp(s->u.CJUMP.left), NULL), NULL));
+					emit(AS_Oper(AS_Code(AS_PUSHL, AS_Src(0), AS_None()), NULL, L(munchExp(s->u.CJUMP.right), NULL), NULL));
+					emit(AS_Oper(AS_Code(AS_PUSHL, AS_Addr(0), AS_None()), NULL, L(munchExp(s->u.CJUMP.left), NULL), NULL));
 				} else {
-					emit(AS_Oper(String("pushl `s0\n"), NULL, L(munchExp(s->u.CJUMP.left), NULL), NULL));
-					emit(AS_Oper(String("pushl $`s0\n"), NULL, L(munchExp(s->u.CJUMP.right), NULL), NULL));
+					emit(AS_Oper(AS_Code(AS_PUSHL, AS_Src(0), AS_None()), NULL, L(munchExp(s->u.CJUMP.left), NULL), NULL));
+					emit(AS_Oper(AS_Code(AS_PUSHL, AS_Addr(0), AS_None()), NULL, L(munchExp(s->u.CJUMP.right), NULL), NULL));
 				}
-				emit(AS_Oper(String("call stringEqual\n"), NULL, NULL, NULL));
+				// stringEqual may have to put a concat together, and so collect
+				if(F_gc)
+					emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Name(Temp_namedlabel("tiger_frame"))),
+						NULL, L(F_FP(), NULL), NULL));
+				emit(AS_Oper(AS_Code(AS_CALL, AS_Name(Temp_namedlabel("stringEqual")), AS_None()),
+					F_gc ? F_registers() : F_callerSaves(), NULL, NULL));
 				Temp_temp r = Temp_newtemp();
-				emit(AS_Oper(String("movl $1, `d0\n"), L(r, NULL), NULL, NULL));
-				emit(AS_Oper(String("cmp `s1, `s0\n"), NULL, L(F_RV(), L(r, NULL)), NULL));
-				jump = "je `j0\n";
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Imm(1), AS_Dst(0)), L(r, NULL), NULL, NULL));
+				emit(AS_Oper(AS_Code(AS_CMP, AS_Src(1), AS_Src(0)), NULL, L(F_RV(), L(r, NULL)), NULL));
+				jump = AS_JE;
 			}
 			else {
-				emit(AS_Oper(String("cmp `s1, `s0\n"), 
+				emit(AS_Oper(AS_Code(AS_CMP, AS_Src(1), AS_Src(0)), 
 					NULL, L(munchExp(s->u.CJUMP.left), L(munchExp(s->u.CJUMP.right), NULL)), NULL));
 				switch(s->u.CJUMP.op) {
 					case T_eq:
-						jump = "je `j0\n"; break;
+						jump = AS_JE; break;
 					case T_ne:
-						jump = "jne `j0\n"; break;
+						jump = AS_JNE; break;
 					case T_lt: 
-						jump = "jl `j0\n"; break;
+						jump = AS_JL; break;
 					case T_gt: 
-						jump = "jg `j0\n"; break;
+						jump = AS_JG; break;
 					case T_le: 
-						jump = "jle `j0\n"; break;
+						jump = AS_JLE; break;
 					case T_ge:
-						jump = "jge `j0\n"; break;
+						jump = AS_JGE; break;
+					case T_ult:
+						jump = AS_JB; break;
+					case T_ugt:
+						jump = AS_JA; break;
+					case T_ule:
+						jump = AS_JBE; break;
+					case T_uge:
+						jump = AS_JAE; break;
 					default:
 						printf("error in munchStm, T_CJUMP, not match op : op kind :%d\n", s->u.CJUMP.op);
 						assert(0);
 				}
 			}
-			emit(AS_Oper(String(jump), NULL, NULL, AS_Targets(Temp_LabelList(s->u.CJUMP.true, NULL))));
+			emit(AS_Oper(AS_Code(jump, AS_Target(0), AS_None()), NULL, NULL, AS_Targets(Temp_LabelList(s->u.CJUMP.true, NULL))));
 			break;
 		}
 		case T_EXP: {
@@ -154,9 +168,9 @@ static Temp_tempList munchArgs(int n,T_expList expList) {
 	Temp_temp r = munchExp(expList->head);
 	Temp_tempList remain = munchArgs(n + 1, expList->tail);
 	if(expList->head->kind == T_NAME)
-		emit(AS_Oper(String("pushl $`s0\n"), NULL, L(r, NULL), NULL));
+		emit(AS_Oper(AS_Code(AS_PUSHL, AS_Addr(0), AS_None()), NULL, L(r, NULL), NULL));
 	else 
-		emit(AS_Oper(String("pushl `s0\n"), NULL, L(r, NULL), NULL));
+		emit(AS_Oper(AS_Code(AS_PUSHL, AS_Src(0), AS_None()), NULL, L(r, NULL), NULL));
 	return L(r, remain);
 }
 
@@ -171,6 +185,8 @@ static int getMemType(T_exp e) {
 	switch(mem->kind) {
 		case T_CONST:
 			return 3;
+		case T_NAME:
+			return 6;
 		case T_BINOP:{
 			if(mem->u.BINOP.left->kind == T_CONST) 
 				return 2;
@@ -194,46 +210,51 @@ static void munchMoveStm(T_stm s) {
 		switch(memType) {
 			case 1: 
 				//MOVE(MEM(e1 + CONST), e2)
-				emit(AS_Oper(createString("movl `s1, %d(`s0)\n", dstMem->u.BINOP.right->u.CONST),
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(1), AS_Disp(dstMem->u.BINOP.right->u.CONST, 0)),
 					NULL, L(munchExp(dstMem->u.BINOP.left), L(munchExp(src), NULL)), NULL));
 				return;
 			case 2:
 				//MOVE(MEM(CONST + e1), e2)
-				emit(AS_Oper(createString("movl `s1, %d(`s0)\n", dstMem->u.BINOP.left->u.CONST),
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(1), AS_Disp(dstMem->u.BINOP.left->u.CONST, 0)),
 					NULL, L(munchExp(dstMem->u.BINOP.right), L(munchExp(src), NULL)), NULL));
 				return;
 			case 3:
 				//MOVE(MEM(CONST), e1)
-				emit(AS_Oper(createString("`s0, (%d)\n", dstMem->u.CONST),
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Abs(dstMem->u.CONST)),
 					NULL, L(munchExp(src), NULL), NULL));
 				return;
 			case 5:
 				//MOVE(MEM(e1 + e2), e3)
-				emit(AS_Oper(String("movl `s1, (`s0)\n"),
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(1), AS_Ind(0)),
 					NULL, L(munchExp(dstMem), L(munchExp(src), NULL)), NULL));
 				return ;
+			case 6:
+				//MOVE(MEM(NAME), e1)
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Name(dstMem->u.NAME)),
+					NULL, L(munchExp(src), NULL), NULL));
+				return;
 				
 		}
 		if(src->kind == T_MEM) {
 			assert(0);
 			//is not support in at&t
 			//MOVE(MEM(e1), MEM(e2))
-			emit(AS_Oper(String("movl M[`s0] <- M[`s1]\n"),
-				NULL, L(munchExp(dstMem), L(munchExp(src->u.MEM), NULL)), NULL));
 		} else {
 			//MOVE(MEM(e1), e2)
 			// printf("here-----------------------------------dstMem->kind:%d dst->kind:%d\n", dstMem->kind, dst->kind);
-			emit(AS_Oper(String("movl `s1, (`s0)\n"),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Src(1), AS_Ind(0)),
 				NULL, L(munchExp(dstMem), L(munchExp(src), NULL)), NULL));
 		}
 	} else {
 		if(dst->kind == T_TEMP) {
 			// MOVE(reg1, reg2)
 			
+			// loading a label's address is not a register copy, so it must not
+			// be offered to the coalescer as a move
 			if(src->kind == T_NAME)
-				emit(AS_Move(String("movl $`s0, `d0\n"), L(dst->u.TEMP, NULL), L(munchExp(src), NULL)));	
+				emit(AS_Oper(AS_Code(AS_MOVL, AS_Addr(0), AS_Dst(0)), L(dst->u.TEMP, NULL), L(munchExp(src), NULL), NULL));	
 			else 
-				emit(AS_Move(String("movl `s0, `d0\n"), L(dst->u.TEMP, NULL), L(munchExp(src), NULL)));	
+				emit(AS_Move(L(dst->u.TEMP, NULL), L(munchExp(src), NULL)));	
 		} else {
 			printf("error: in munch move: unknown type :src->kind:%d, dst->kind:%d\n", src->kind, dst->kind);
 		}
@@ -248,38 +269,45 @@ static Temp_temp munchMemExp(T_exp e) {
 		case 1: {
 			// LOAD register <- M[`s0+ CONST]
 			Temp_temp r = Temp_newtemp();
-			emit(AS_Oper(createString("movl %d(`s0), `d0\n", mem->u.BINOP.right->u.CONST),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Disp(mem->u.BINOP.right->u.CONST, 0), AS_Dst(0)),
 					L(r, NULL), L(munchExp(mem->u.BINOP.left), NULL), NULL));
 			return r;
 		}
 		case 2: {
 			//LOAD `d0 <- M[`s0+%d]
 			Temp_temp r = Temp_newtemp();
-			emit(AS_Oper(createString("movl %d(`s0), `d0\n", mem->u.BINOP.left->u.CONST),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Disp(mem->u.BINOP.left->u.CONST, 0), AS_Dst(0)),
 					L(r, NULL), L(munchExp(mem->u.BINOP.right), NULL), NULL));
 			return r;
 		}
 		case 3: {
 			//LOAD `d0 <- M[r0+%d]
 			Temp_temp r = Temp_newtemp();
-			emit(AS_Oper(createString("movl (%d), `d0\n", mem->u.CONST),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Abs(mem->u.CONST), AS_Dst(0)),
 				L(r, NULL), NULL, NULL));
 			return r;
 		}
 		case 4: {
 			//LOAD `d0 <- M[r0+%d]
 			Temp_temp r = Temp_newtemp();
-			emit(AS_Oper(String("movl (`s0), `d0\n"),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Ind(0), AS_Dst(0)),
 					L(r, NULL), L(munchExp(mem), NULL), NULL));
 			return r;
 		}
 		case 5: {
 			//LOAD `d0 <- M[`s0+`s1]
 			Temp_temp r = Temp_newtemp();
-			emit(AS_Oper(String("movl (`s0), `d0\n"),
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Ind(0), AS_Dst(0)),
 					L(r, NULL), L(munchExp(mem), NULL), NULL));
 			return r;
 		}
+		case 6: {
+			//LOAD `d0 <- M[label]
+			Temp_temp r = Temp_newtemp();
+			emit(AS_Oper(AS_Code(AS_MOVL, AS_Name(mem->u.NAME), AS_Dst(0)),
+					L(r, NULL), NULL, NULL));
+			return r;
+		}
 		default: {
 			assert(0);
 			printf("error in munchMemExp : should not be here\n");
@@ -291,30 +319,30 @@ static Temp_temp munchMemExp(T_exp e) {
 
 static Temp_temp munchOpExp(T_exp e) {
 	Temp_temp r = Temp_newtemp();
-	string instr, op;
-	char buf[100];
+	AS_opcode instr;
+	string op;
 	switch(e->u.BINOP.op) {
 		case T_plus: 
-			instr = "addl"; op = "+"; break;
+			instr = AS_ADDL; op = "+"; break;
 		case T_minus: 
-			instr = "subl"; op = "-"; break;
+			instr = AS_SUBL; op = "-"; break;
 		case T_mul: 
-			instr = "imull"; op = "*"; break;
+			instr = AS_IMULL; op = "*"; break;
 		case T_div: {
-			instr = "idivl"; op = "/"; 
+			instr = AS_IDIVL; op = "/"; 
 
 			Temp_temp tEax = Temp_newtemp();
 			Temp_temp tEdx = Temp_newtemp();
-			emit(AS_Move(String("movl `s0, `d0\n"), L(tEax, NULL), L(F_DivLOW(), NULL)));	
-			emit(AS_Move(String("movl `s0, `d0\n"), L(tEdx, NULL), L(F_DivUP(), NULL)));	
-			emit(AS_Move(String("movl `s0, `d0\n"), L(F_DivLOW(), NULL), 
+			emit(AS_Move(L(tEax, NULL), L(F_DivLOW(), NULL)));	
+			emit(AS_Move(L(tEdx, NULL), L(F_DivUP(), NULL)));	
+			emit(AS_Move(L(F_DivLOW(), NULL), 
 				L(munchExp(e->u.BINOP.left), NULL)));	
-			emit(AS_Oper(String("cltd\n"), L(F_DivUP(), NULL), L(F_DivLOW(), NULL), NULL));	
-			emit(AS_Oper(String("idivl `s0\n"), L(F_DivLOW(), L(F_DivUP(), NULL)), 
+			emit(AS_Oper(AS_Code(AS_CLTD, AS_None(), AS_None()), L(F_DivUP(), NULL), L(F_DivLOW(), NULL), NULL));	
+			emit(AS_Oper(AS_Code(AS_IDIVL, AS_Src(0), AS_None()), L(F_DivLOW(), L(F_DivUP(), NULL)), 
 				L(munchExp(e->u.BINOP.right), L(F_DivLOW(), L(F_DivUP(), NULL))), NULL));	
-			emit(AS_Move(String("movl `s0, `d0\n"), L(r, NULL), L(F_DivLOW(), NULL)));	
-			emit(AS_Move(String("movl `s0, `d0\n"), L(F_DivLOW(), NULL), L(tEax, NULL)));	
-			emit(AS_Move(String("movl `s0, `d0\n"), L(F_DivUP(), NULL), L(tEdx, NULL)));	
+			emit(AS_Move(L(r, NULL), L(F_DivLOW(), NULL)));	
+			emit(AS_Move(L(F_DivLOW(), NULL), L(tEax, NULL)));	
+			emit(AS_Move(L(F_DivUP(), NULL), L(tEdx, NULL)));	
 			return r;
 			// move edx , eax
 			// do div
@@ -327,22 +355,19 @@ static Temp_temp munchOpExp(T_exp e) {
 	if(e->u.BINOP.left->kind == T_CONST) {
 		// r = munchExp(e->u.BINOP.right);
 		Temp_temp right = munchExp(e->u.BINOP.right);
-		emit(AS_Move(String("movl `s0, `d0\n"), L(r, NULL), L(right, NULL)));
-		sprintf(buf, "%s $%d, `d0\n", instr, e->u.BINOP.left->u.CONST);
-		emit(AS_Oper(String(buf), L(r, NULL), L(r, L(right, NULL)), NULL));
+		emit(AS_Move(L(r, NULL), L(right, NULL)));
+		emit(AS_Oper(AS_Code(instr, AS_Imm(e->u.BINOP.left->u.CONST), AS_Dst(0)), L(r, NULL), L(r, L(right, NULL)), NULL));
 	} else if(e->u.BINOP.right->kind == T_CONST) {
 		// r = munchExp(e->u.BINOP.left);
 		Temp_temp left = munchExp(e->u.BINOP.left);
-		emit(AS_Move(String("movl `s0, `d0\n"), L(r, NULL), L(left, NULL)));
-		sprintf(buf, "%s $%d, `d0\n", instr, e->u.BINOP.right->u.CONST);
-		emit(AS_Oper(String(buf), L(r, NULL), L(r, NULL), NULL));
+		emit(AS_Move(L(r, NULL), L(left, NULL)));
+		emit(AS_Oper(AS_Code(instr, AS_Imm(e->u.BINOP.right->u.CONST), AS_Dst(0)), L(r, NULL), L(r, NULL), NULL));
 	} else {
 		// Temp_temp left = munchExp(e->u.BINOP.left);
 		// Temp_temp right = munchExp(e->u.BINOP.right);
-		// emit(AS_Move(String("movl `s0, `d0\n"), L(r, NULL), L(left, L(right, NULL))));
+		// emit(AS_Move(L(r, NULL), L(left, L(right, NULL))));
 		r = munchExp(e->u.BINOP.left);
-		sprintf(buf, "%s `s0, `d0\n", instr);
-		emit(AS_Oper(String(buf), L(r, NULL), L(munchExp(e->u.BINOP.right), L(r, NULL)), NULL));
+		emit(AS_Oper(AS_Code(instr, AS_Src(0), AS_Dst(0)), L(r, NULL), L(munchExp(e->u.BINOP.right), L(r, NULL)), NULL));
 	}
 	return r;
 }
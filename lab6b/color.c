@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "util.h"
 #include "symbol.h"
 #include "temp.h"
@@ -9,45 +10,93 @@
 #include "graph.h"
 #include "table.h"
 #include "color.h"
-
-FILE *fp = NULL;
+#include "trace.h"
 
 /* register(color) number */
-int K;
-
-// node work-list, sets and stacks
-Temp_map      precolored;
-My_G_nodeList initial          ,            //temporary registers, not precolored and not yet processed
-              simplifyWorklist ,
-              freezeWorklist   ,
-              spillWorklist    ,
-              spilledNodes     ,
-              coalescedNodes   ,
-              coloredNodes     ,
-              selectStack      ;
+static __thread int K;
+
+// Every node is in exactly one of these sets and every move in exactly one
+// of the move sets.  Each set is a doubly-linked list threaded through
+// per-node (per-move) records, and each record is tagged with the set it
+// is in, so membership tests and moving between sets are O(1).
+enum nodeSet {
+    PRECOLORED,                 // machine registers
+    INITIAL,                    // temporary registers, not precolored and not yet processed
+    SIMPLIFY_WORKLIST,
+    FREEZE_WORKLIST,
+    SPILL_WORKLIST,
+    SPILLED_NODES,
+    COALESCED_NODES,
+    COLORED_NODES,
+    SELECT_STACK,
+    NODE_SETS
+};
+
+enum moveSet {
+    COALESCED_MOVES,
+    CONSTRAINED_MOVES,
+    FROZEN_MOVES,
+    WORKLIST_MOVES,             // moves possiable for coalescing
+    ACTIVE_MOVES,               // moves not yet ready for coalescing
+    MOVE_SETS
+};
+
+// list links of a node or a move; -1 ends a list
+struct link {
+    int set;
+    int prev, next;
+};
+
+struct setList {
+    int head, tail;
+};
+
+// adjacency vector of a node, indexed by G_nodeKey
+struct adjVector {
+    G_node *nodes;
+    int count, max;
+};
+
+// moves involving a node, as indices into moves[]
+struct moveVector {
+    int *moves;
+    int count, max;
+};
+
+struct move {
+    G_node src, dst;
+};
+
+// The allocator state is per thread, so functions can be colored in
+// parallel.
+
+// node work-list, sets and stacks, indexed by G_nodeKey
+static __thread Temp_map         precolored;
+static __thread G_node           *nodes      = NULL;
+static __thread struct link      *nodeLinks  = NULL;
+static __thread struct setList   nodeSets[NODE_SETS];
 
 // Move sets
-My_Live_moveList coalescedMoves   ,
-                 constrainedMoves ,
-                 frozenMoves      ,       
-                 worklistMoves    ,     // moves possiable for coalescing
-                 activeMoves      ;     // moves not yet ready for coalescing
+static __thread struct move      *moves      = NULL;
+static __thread struct link      *moveLinks  = NULL;
+static __thread bool             *moveMark   = NULL;   // scratch for COL_combine, all FALSE
+static __thread struct setList   moveSets[MOVE_SETS];
+static __thread int              nmoves;
 
 // Others DS
-int            *degree  = NULL;
-My_G_bitMatrix adjSet   = NULL;        // G_node -> G_node
-G_table        adjList  = NULL,
-               moveList = NULL,        // G_node -> Live_moveList
-               alias    = NULL,        // G_node -> G_node
-               color    = NULL;        // G_node -> [TODO]color
-Temp_map       colorMap;
+static __thread int            *degree  = NULL;
+static __thread My_G_bitMatrix adjSet   = NULL;        // G_node -> G_node
+static __thread struct adjVector *adjList = NULL;      // G_node -> its neighbours, no duplicates
+static __thread struct moveVector *moveList = NULL;    // G_node -> moves
+static __thread G_table        alias    = NULL,        // G_node -> G_node
+                               color    = NULL;        // G_node -> [TODO]color
+static __thread Temp_map       colorMap;
 
 /* function declearation */
 void COL_makeWorklist();
-My_Live_moveList COL_nodeMoves(G_node n);
 bool COL_moveRelated(G_node n);    
 void COL_decrementDegree(G_node n);        
-void COL_enableMoves(My_G_nodeList list); 
+void COL_enableMoves(G_node n); 
 void COL_simplify();                
 void COL_coalesce();   
 void COL_combine(G_node u, G_node v);
@@ -60,50 +109,110 @@ void COL_freezeMoves(G_node);
 void COL_selectSpill(); 
 void COL_assignColors(Temp_tempList);
 void COL_addEdge(G_node u, G_node v); 
-My_G_nodeList COL_adjacent(G_node n);
+bool COL_inGraph(G_node n);
 bool isPrecolored(G_node n);
 
-My_Live_moveList G_lookupMoveList(G_node n) {
-    My_Live_moveList t = G_look(moveList, n);
-    if( t == NULL ) {
-        t = My_Empty_Live_moveList();
-        G_enter(moveList, n, t);
+/* intrusive set lists */
+
+// unlink element i from whatever set it is in
+static void unlinkElem(struct link *links, struct setList *sets, int i) {
+    struct link *l = &links[i];
+    if(l->prev >= 0)
+        links[l->prev].next = l->next;
+    else
+        sets[l->set].head = l->next;
+    if(l->next >= 0)
+        links[l->next].prev = l->prev;
+    else
+        sets[l->set].tail = l->prev;
+}
+
+// move element i to the end of set s; a new element has set -1
+static void moveElem(struct link *links, struct setList *sets, int i, int s) {
+    struct link *l = &links[i];
+    if(l->set == s)
+        return;
+    if(l->set >= 0)
+        unlinkElem(links, sets, i);
+    l->set = s;
+    l->next = -1;
+    l->prev = sets[s].tail;
+    if(sets[s].tail >= 0)
+        links[sets[s].tail].next = i;
+    else
+        sets[s].head = i;
+    sets[s].tail = i;
+}
+
+static bool inNodeSet(G_node n, enum nodeSet s) {
+    return nodeLinks[G_nodeKey(n)].set == s;
+}
+
+static bool emptyNodeSet(enum nodeSet s) {
+    return nodeSets[s].head < 0;
+}
+
+static void toNodeSet(G_node n, enum nodeSet s) {
+    moveElem(nodeLinks, nodeSets, G_nodeKey(n), s);
+}
+
+static bool inMoveSet(int m, enum moveSet s) {
+    return moveLinks[m].set == s;
+}
+
+static void toMoveSet(int m, enum moveSet s) {
+    moveElem(moveLinks, moveSets, m, s);
+}
+
+// a move still being considered for coalescing
+static bool pendingMove(int m) {
+    return inMoveSet(m, ACTIVE_MOVES) || inMoveSet(m, WORKLIST_MOVES);
+}
+
+// append v to u's adjacency vector, doubling it when full
+void appendAdjVector(G_node u, G_node v) {
+    struct adjVector *a = &adjList[G_nodeKey(u)];
+    if(a->count == a->max) {
+        G_node *old = a->nodes;
+        a->max = a->max ? 2 * a->max : 4;
+        a->nodes = checked_malloc(a->max * sizeof(G_node));
+        if(a->count)
+            memcpy(a->nodes, old, a->count * sizeof(G_node));
     }
-    return t;
+    a->nodes[a->count++] = v;
 }
 
-My_G_nodeList G_lookupAdjNodeList(G_node n) {
-    My_G_nodeList t = G_look(adjList, n);
-    if(t == NULL) {
-        t = My_Empty_G_nodeList();
-        G_enter(adjList, n, t);
+// append move m to n's move vector, doubling it when full
+void appendMoveVector(G_node n, int m) {
+    struct moveVector *a = &moveList[G_nodeKey(n)];
+    if(a->count == a->max) {
+        int *old = a->moves;
+        a->max = a->max ? 2 * a->max : 4;
+        a->moves = checked_malloc(a->max * sizeof(int));
+        if(a->count)
+            memcpy(a->moves, old, a->count * sizeof(int));
     }
-    return t;
+    a->moves[a->count++] = m;
 }
 
 void COL_assignColors(Temp_tempList regs) {
     bool *okColor = checked_malloc(K*sizeof(bool));
     int i = 0;
-    // G_nodeList nodes = selectStack->head;
-    // int count =  0;
-    // for(; nodes; nodes = nodes->tail)
-    //     count++;
-    // fprintf(fp, "----------------%d-------------\n", count);
-    // fprintf(fp, "%d %s\n", getTempNum(F_FP()), Temp_look(precolored, F_FP()));
     
-    while(emptyMyGnodeList(selectStack) == FALSE) {
-        G_node n = popMyGnodeList(selectStack);
+    while(emptyNodeSet(SELECT_STACK) == FALSE) {
+        G_node n = nodes[nodeSets[SELECT_STACK].tail];
         if(isPrecolored(n) == TRUE) {
             assert(0);
         }
-        fprintf(fp, "reg:%d\n", getTempNum(Live_gtemp(n)));
+        TR_printf(TR_COLORING, "reg:%d\n", getTempNum(Live_gtemp(n)));
         for(i = 0; i < K; ++i) {
             okColor[i] = TRUE;
         }
-        G_nodeList adj = G_lookupAdjNodeList(n)->head;
-        for(; adj; adj = adj->tail) {
-            G_node w = COL_getAlias(adj->head);
-            fprintf(fp, "check - reg:%d - n:%d\n", getTempNum(Live_gtemp(adj->head)), (int)G_look(color, w));
+        struct adjVector *adj = &adjList[G_nodeKey(n)];
+        int j = 0;
+        for(; j < adj->count; ++j) {
+            G_node w = COL_getAlias(adj->nodes[j]);
+            TR_printf(TR_COLORING, "check - reg:%d - n:%d\n", getTempNum(Live_gtemp(adj->nodes[j])), (int)G_look(color, w));
             if(isPrecolored(w)) {
                 int k = 0;
                 Temp_tempList tRegs = regs;
@@ -115,7 +224,7 @@ void COL_assignColors(Temp_tempList regs) {
                 if(k < K)
                     okColor[k] = FALSE;
             }
-            else if(isPrecolored(w) || findInMyGnodeList(coloredNodes, w)) {
+            else if(inNodeSet(w, COLORED_NODES)) {
                 okColor[(int)G_look(color, w)] = FALSE;
             }
         }
@@ -129,153 +238,135 @@ void COL_assignColors(Temp_tempList regs) {
                 break;
             }
         }
-        fprintf(fp, "color:%d, %s\n", k, Temp_look(precolored, reg));
+        TR_printf(TR_COLORING, "color:%d, %s\n", k, k >= 0 ? Temp_look(precolored, reg) : "spilled");
         if(k == -1) {
-            checkedAppendMyGnodeList(spilledNodes, n);
+            toNodeSet(n, SPILLED_NODES);
         } else {
-            checkedAppendMyGnodeList(coloredNodes, n);
+            toNodeSet(n, COLORED_NODES);
             G_enter(color, n, k);
-            // fprintf(fp, "color:%d - %s\n", getTempNum(Live_gtemp(n)), Temp_look(precolored, reg));
             Temp_enter(colorMap, Live_gtemp(n), Temp_look(precolored, reg));
         }
     }
-    G_nodeList tList = coalescedNodes->head;
-    for(; tList; tList = tList->tail) {
-        // fprintf(fp, "last:color:%d  alias:%d - %s\n", getTempNum(Live_gtemp(tList->head)), 
-            // getTempNum(Live_gtemp(COL_getAlias(tList->head))),
-            // Temp_look(precolored, Live_gtemp(COL_getAlias(tList->head))));
-        Temp_enter(colorMap, Live_gtemp(tList->head), 
-                    Temp_look(colorMap, Live_gtemp(COL_getAlias(tList->head))));
+    for(i = nodeSets[COALESCED_NODES].head; i >= 0; i = nodeLinks[i].next) {
+        Temp_enter(colorMap, Live_gtemp(nodes[i]), 
+                    Temp_look(colorMap, Live_gtemp(COL_getAlias(nodes[i]))));
     }
 }
 
 void COL_selectSpill() {
-    G_nodeList tList = spillWorklist->head;
     G_node p = NULL;
-    for(; tList; tList = tList->tail) {
-        if(isPrecolored(tList->head)) {
+    int i = nodeSets[SPILL_WORKLIST].head;
+    for(; i >= 0; i = nodeLinks[i].next) {
+        if(isPrecolored(nodes[i])) {
             assert(0);
         }
-        if(p == NULL) {
-            // if(isPrecolored(tList->head) == FALSE) {
-                p = tList->head;
-            // }
-        }
-        else if(degree[G_nodeKey(p)] < degree[G_nodeKey(tList->head)]) {
-            // if(isPrecolored(tList->head) == FALSE)
-                p = tList->head;
+        if(p == NULL || degree[G_nodeKey(p)] < degree[i]) {
+            p = nodes[i];
         }
     }
 
-    fprintf(fp, "spill:%d\n", getTempNum(Live_gtemp(p)));
+    TR_printf(TR_COLORING, "spill:%d\n", getTempNum(Live_gtemp(p)));
 
-    spillWorklist = subMyGnodeList(spillWorklist, 
-                        cloneFromGnodeList(G_NodeList(p, NULL)));
-    // fprintf(fp, "selectspill : reg %d\n", getTempNum(Live_gtemp(p)));
-    checkedAppendMyGnodeList(simplifyWorklist, p);
+    toNodeSet(p, SIMPLIFY_WORKLIST);
     COL_freezeMoves(p);
 }
 
 void COL_freezeMoves(G_node u) {
-    fprintf(fp, "freeze:%d\n", getTempNum(Live_gtemp(u)));
+    TR_printf(TR_COLORING, "freeze:%d\n", getTempNum(Live_gtemp(u)));
 
-    My_Live_moveList lists = COL_nodeMoves(u);
-    Live_moveList tList = lists->head;
-    for(; tList; tList = tList->tail) {
-        G_node x = tList->src;
-        G_node y = tList->dst;
+    struct moveVector *ml = &moveList[G_nodeKey(u)];
+    int i = 0;
+    for(; i < ml->count; ++i) {
+        int m = ml->moves[i];
+        if(pendingMove(m) == FALSE)
+            continue;
+        G_node x = moves[m].src;
+        G_node y = moves[m].dst;
         G_node v;
         if(COL_getAlias(y) == COL_getAlias(u)) {
             v = COL_getAlias(x);
         } else {
             v = COL_getAlias(y);
         }
-        activeMoves = subMyLiveMoveList(activeMoves, 
-                            cloneFromLiveMoveList(Live_MoveList(x, y, NULL)));
-        checkedAppendMyLiveMoveList(frozenMoves, x, y);
-        if(COL_moveRelated(v) == FALSE && degree[G_nodeKey(v)] < K) {
-            freezeWorklist =  subMyGnodeList(freezeWorklist, 
-                                        cloneFromGnodeList(G_NodeList(v, NULL)));
-            // fprintf(fp, "freezemove : reg %d\n", getTempNum(Live_gtemp(v)));
-            if(isPrecolored(v) == FALSE)
-                checkedAppendMyGnodeList(simplifyWorklist, v);
+        toMoveSet(m, FROZEN_MOVES);
+        if(COL_moveRelated(v) == FALSE && degree[G_nodeKey(v)] < K
+            && isPrecolored(v) == FALSE) {
+            toNodeSet(v, SIMPLIFY_WORKLIST);
         }
     }
 }   
 
 
 void COL_freeze() {
-    G_node u = popMyGnodeList(freezeWorklist);
-    // fprintf(fp, "freeze : reg %d\n", getTempNum(Live_gtemp(u)));
-    checkedAppendMyGnodeList(simplifyWorklist, u);
+    G_node u = nodes[nodeSets[FREEZE_WORKLIST].head];
+    toNodeSet(u, SIMPLIFY_WORKLIST);
     COL_freezeMoves(u);
 }
 
 
 void COL_addEdge(G_node u, G_node v) {
+    // adjSet is symmetric, and a new edge is new to both adjacency vectors
     if(My_G_bitMatrixIsConnect(adjSet, G_nodeKey(u), G_nodeKey(v)) == FALSE
         && u != v) {
         My_G_bitMatrixAdd(adjSet, G_nodeKey(u), G_nodeKey(v));
-        My_G_bitMatrixAdd(adjSet, G_nodeKey(v), G_nodeKey(u));
         if(isPrecolored(u) == FALSE) {
-            checkedAppendMyGnodeList(G_lookupAdjNodeList(u), v);
+            appendAdjVector(u, v);
             degree[G_nodeKey(u)] += 1;
         } 
         if(isPrecolored(v) == FALSE) {
-            checkedAppendMyGnodeList(G_lookupAdjNodeList(v), u);
+            appendAdjVector(v, u);
             degree[G_nodeKey(v)] += 1;
         }
     }
 }
 
 void COL_combine(G_node u, G_node v) {
-    fprintf(fp, "combine,  %d -> %d \n", getTempNum(Live_gtemp(v)), getTempNum(Live_gtemp(u)));
-    if(findInMyGnodeList(freezeWorklist, v) == TRUE) {
-        freezeWorklist = subMyGnodeList(freezeWorklist, 
-                            cloneFromGnodeList(G_NodeList(v, NULL)));
-    } else {
-        spillWorklist = subMyGnodeList(spillWorklist, 
-                            cloneFromGnodeList(G_NodeList(v, NULL)));
-    }
-    checkedAppendMyGnodeList(coalescedNodes, v);
+    TR_printf(TR_COLORING, "combine,  %d -> %d \n", getTempNum(Live_gtemp(v)), getTempNum(Live_gtemp(u)));
+    toNodeSet(v, COALESCED_NODES);
     G_enter(alias, v, u);
-    My_Live_moveList l = G_lookupMoveList(u);
-    G_enter(moveList, u, unionMyLiveMoveList(l, G_lookupMoveList(v)));
-    My_G_nodeList lists = COL_adjacent(v);
-    G_nodeList tList = lists->head;
-    for(; tList; tList = tList->tail) {
-        COL_addEdge(tList->head, u);
-        COL_decrementDegree(tList->head);
+
+    // moveList[u] = moveList[u] union moveList[v]
+    struct moveVector *mu = &moveList[G_nodeKey(u)], *mv = &moveList[G_nodeKey(v)];
+    int i = 0, nu = mu->count;
+    for(i = 0; i < nu; ++i)
+        moveMark[mu->moves[i]] = TRUE;
+    for(i = 0; i < mv->count; ++i) {
+        if(moveMark[mv->moves[i]] == FALSE)
+            appendMoveVector(u, mv->moves[i]);
     }
-    if(degree[G_nodeKey(u)] >= K && findInMyGnodeList(freezeWorklist, u) == TRUE) {
-        freezeWorklist = subMyGnodeList(freezeWorklist, 
-                                cloneFromGnodeList(G_NodeList(u, NULL)));
-        fprintf(fp, "combine, add %d -> spillWorklist \n", getTempNum(Live_gtemp(u)));
-        checkedAppendMyGnodeList(spillWorklist, u);
+    for(i = 0; i < nu; ++i)
+        moveMark[moveList[G_nodeKey(u)].moves[i]] = FALSE;
+
+    struct adjVector *adj = &adjList[G_nodeKey(v)];
+    for(i = 0; i < adj->count; ++i) {
+        G_node t = adj->nodes[i];
+        if(COL_inGraph(t) == FALSE)
+            continue;
+        COL_addEdge(t, u);
+        COL_decrementDegree(t);
+    }
+    if(degree[G_nodeKey(u)] >= K && inNodeSet(u, FREEZE_WORKLIST)) {
+        TR_printf(TR_COLORING, "combine, add %d -> spillWorklist \n", getTempNum(Live_gtemp(u)));
+        toNodeSet(u, SPILL_WORKLIST);
     }
 }
 
 bool isPrecolored(G_node n) {
-    // if(Temp_look(F_preColored(), Live_gtemp(n)) == NULL)
-    if(Temp_look(precolored, Live_gtemp(n)) == NULL)
-        return FALSE;
-    return TRUE;
+    return inNodeSet(n, PRECOLORED);
 }
 
 
 G_node COL_getAlias(G_node m) {
     assert(m);
-    G_node alias_m = G_look(alias, m);
-    if(alias_m == m)
-        return m;
-    return COL_getAlias(alias_m);
+    while(inNodeSet(m, COALESCED_NODES))
+        m = G_look(alias, m);
+    return m;
 }
 
 void COL_addWorkList(G_node n) {
     if(isPrecolored(n) == FALSE  && COL_moveRelated(n) == FALSE 
             && degree[G_nodeKey(n)] < K) {
-        freezeWorklist = subMyGnodeList(freezeWorklist, cloneFromGnodeList(G_NodeList(n, NULL)));
-        checkedAppendMyGnodeList(simplifyWorklist, n);
+        toNodeSet(n, SIMPLIFY_WORKLIST);
     }
 }
 
@@ -289,21 +380,30 @@ bool COL_OK(G_node t, G_node r) {
 
 // u <- v
 bool checkGeorge(G_node u, G_node v) {
-    My_G_nodeList lists = COL_adjacent(v);
-    G_nodeList tList = lists->head;
-    for(; tList; tList = tList->tail) {
-        if(COL_OK(tList->head, u) == FALSE)
+    struct adjVector *adj = &adjList[G_nodeKey(v)];
+    int i = 0;
+    for(; i < adj->count; ++i) {
+        if(COL_inGraph(adj->nodes[i]) && COL_OK(adj->nodes[i], u) == FALSE)
             return FALSE;
     }
     return TRUE;
 }
 
+// Briggs: count the significant-degree neighbours of u and v together.
+// u and v do not interfere, so a neighbour of v is also one of u's
+// exactly when adjSet has it next to u.
 bool COL_conservative(G_node u, G_node v) {
-    My_G_nodeList lists = unionMyGnodeList(COL_adjacent(u), COL_adjacent(v));
-    int k = 0;
-    G_nodeList tList = lists->head;
-    for(; tList; tList = tList->tail) {
-        if(degree[G_nodeKey(tList->head)] >= K)
+    int k = 0, i;
+    struct adjVector *adj = &adjList[G_nodeKey(u)];
+    for(i = 0; i < adj->count; ++i) {
+        if(COL_inGraph(adj->nodes[i]) && degree[G_nodeKey(adj->nodes[i])] >= K)
+            k += 1;
+    }
+    adj = &adjList[G_nodeKey(v)];
+    for(i = 0; i < adj->count; ++i) {
+        G_node t = adj->nodes[i];
+        if(COL_inGraph(t) && degree[G_nodeKey(t)] >= K
+            && My_G_bitMatrixIsConnect(adjSet, G_nodeKey(t), G_nodeKey(u)) == FALSE)
             k += 1;
     }
     if(k < K)
@@ -312,16 +412,11 @@ bool COL_conservative(G_node u, G_node v) {
 }
 
 void COL_coalesce() {
-    G_node x = worklistMoves->head->src;
-    G_node y = worklistMoves->head->dst;
-    popMyLiveMoveList(worklistMoves);
-
-    if(findInMyLiveMoveList(frozenMoves, x, y) == TRUE) {
-        fprintf(fp, "frozen coalescing:%d -> %d\n", getTempNum(Live_gtemp(x)), getTempNum(Live_gtemp(y)));        
-        return;
-    }
+    int m = moveSets[WORKLIST_MOVES].head;
+    G_node x = moves[m].src;
+    G_node y = moves[m].dst;
 
-    fprintf(fp, "coalescing:%d -> %d\n", getTempNum(Live_gtemp(x)), getTempNum(Live_gtemp(y)));
+    TR_printf(TR_COLORING, "coalescing:%d -> %d\n", getTempNum(Live_gtemp(x)), getTempNum(Live_gtemp(y)));
 
     G_node u = COL_getAlias(x);
     G_node v = COL_getAlias(y);
@@ -332,41 +427,35 @@ void COL_coalesce() {
         v = t;
     }
 
-    fprintf(fp, "checked precolored.coalescing:%d -> %d\n", getTempNum(Live_gtemp(v)), getTempNum(Live_gtemp(u)));
+    TR_printf(TR_COLORING, "checked precolored.coalescing:%d -> %d\n", getTempNum(Live_gtemp(v)), getTempNum(Live_gtemp(u)));
 
     if(u == v) {
-        checkedAppendMyLiveMoveList(coalescedMoves, x, y);
+        toMoveSet(m, COALESCED_MOVES);
         COL_addWorkList(u);
     } else if(isPrecolored(v) == TRUE 
         || My_G_bitMatrixIsConnect(adjSet, G_nodeKey(u), G_nodeKey(v)) == TRUE) {
-        fprintf(fp, "coalescing : constrainedMoves\n");
-        checkedAppendMyLiveMoveList(constrainedMoves, x, y);
+        TR_printf(TR_COLORING, "coalescing : constrainedMoves\n");
+        toMoveSet(m, CONSTRAINED_MOVES);
         COL_addWorkList(u);
         COL_addWorkList(v);
     } else if( (isPrecolored(u) == TRUE && checkGeorge(u, v))
                 || (isPrecolored(u) == FALSE && COL_conservative(u, v)) ) {
-        fprintf(fp, "coalescing : combine\n");
-        checkedAppendMyLiveMoveList(coalescedMoves, x, y);
+        TR_printf(TR_COLORING, "coalescing : combine\n");
+        toMoveSet(m, COALESCED_MOVES);
         COL_combine(u, v);
         COL_addWorkList(u);
     } else {
-        fprintf(fp, "coalescing : Coalescing fail.\n");
-        checkedAppendMyLiveMoveList(activeMoves, x, y);
+        TR_printf(TR_COLORING, "coalescing : Coalescing fail.\n");
+        toMoveSet(m, ACTIVE_MOVES);
     }
 }
 
-void COL_enableMoves(My_G_nodeList list) {
-    G_nodeList tList = list->head;
-    for(; tList; tList = tList->tail) {
-        My_Live_moveList moves = COL_nodeMoves(tList->head);
-        Live_moveList tMoves = moves->head;
-        for(; tMoves; tMoves = tMoves->tail) {
-            if(findInMyLiveMoveList(activeMoves, tMoves->src, tMoves->dst) == TRUE) {
-                activeMoves = subMyLiveMoveList(activeMoves, 
-                                cloneFromLiveMoveList(Live_MoveList(tMoves->src, tMoves->dst, NULL)));
-                checkedAppendMyLiveMoveList(worklistMoves, tMoves->src, tMoves->dst);
-            }
-        }
+void COL_enableMoves(G_node n) {
+    struct moveVector *ml = &moveList[G_nodeKey(n)];
+    int i = 0;
+    for(; i < ml->count; ++i) {
+        if(inMoveSet(ml->moves[i], ACTIVE_MOVES))
+            toMoveSet(ml->moves[i], WORKLIST_MOVES);
     }
 }
 
@@ -374,94 +463,89 @@ void COL_decrementDegree(G_node m) {
     int d = degree[G_nodeKey(m)];
     degree[G_nodeKey(m)] -= 1;
     if( d == K ) {
-        My_G_nodeList adj = COL_adjacent(m);
-        checkedAppendMyGnodeList(adj, m);
-        COL_enableMoves(adj);
-        spillWorklist = subMyGnodeList(spillWorklist, 
-                                cloneFromGnodeList(G_NodeList(m, NULL)));
+        struct adjVector *adj = &adjList[G_nodeKey(m)];
+        int i = 0;
+        for(; i < adj->count; ++i) {
+            if(COL_inGraph(adj->nodes[i]))
+                COL_enableMoves(adj->nodes[i]);
+        }
+        COL_enableMoves(m);
         if(COL_moveRelated(m)) {
-            checkedAppendMyGnodeList(freezeWorklist, m);
+            toNodeSet(m, FREEZE_WORKLIST);
         } else if(isPrecolored(m) == FALSE){
-            // fprintf(fp, "COL_decrementDegree : reg %d\n", getTempNum(Live_gtemp(m)));
-            checkedAppendMyGnodeList(simplifyWorklist, m);
+            toNodeSet(m, SIMPLIFY_WORKLIST);
         }
     }
 }
 
-My_G_nodeList COL_adjacent(G_node n) {
-    My_G_nodeList adj = G_lookupAdjNodeList(n);
-    return subMyGnodeList(adj, unionMyGnodeList(selectStack, coalescedNodes));
+// n is still in the graph: neither removed by simplify nor merged away
+bool COL_inGraph(G_node n) {
+    return !inNodeSet(n, SELECT_STACK) && !inNodeSet(n, COALESCED_NODES);
 }
 
 void COL_simplify() {
-    G_node n = popMyGnodeList(simplifyWorklist);
-    fprintf(fp, "simplify:%d\n", getTempNum(Live_gtemp(n)));
-    if(isPrecolored(n) == TRUE) {
-        fprintf(fp, "simplify precolored reg%d\n", getTempNum(Live_gtemp(n)));
-        return;
-    }
-    insertFrontMyGnodeList(selectStack, n);
-    My_G_nodeList adj = COL_adjacent(n);
-    G_nodeList list = adj->head;
-    for(; list; list = list->tail) {
-        COL_decrementDegree(list->head);
+    G_node n = nodes[nodeSets[SIMPLIFY_WORKLIST].head];
+    TR_printf(TR_COLORING, "simplify:%d\n", getTempNum(Live_gtemp(n)));
+    toNodeSet(n, SELECT_STACK);
+    struct adjVector *adj = &adjList[G_nodeKey(n)];
+    int i = 0;
+    for(; i < adj->count; ++i) {
+        if(COL_inGraph(adj->nodes[i]))
+            COL_decrementDegree(adj->nodes[i]);
     }
 }
 
 
-My_Live_moveList COL_nodeMoves(G_node n) {
-    My_Live_moveList t = G_lookupMoveList(n);
-    t = interectMyLiveMoveList(t, unionMyLiveMoveList(activeMoves, worklistMoves));
-    return t;
-} 
-
 bool COL_moveRelated(G_node n) {
-    if(emptyMyLiveMoveList(COL_nodeMoves(n)) == TRUE)
-        return FALSE;
-    else
-        return TRUE;    
+    struct moveVector *ml = &moveList[G_nodeKey(n)];
+    int i = 0;
+    for(; i < ml->count; ++i) {
+        if(pendingMove(ml->moves[i]))
+            return TRUE;
+    }
+    return FALSE;
 }
 
 void COL_makeWorklist() {
-    G_nodeList list = initial->head;
-    for(; list; list = list->tail) {
-        if(degree[G_nodeKey(list->head)] >= K) {
-            checkedAppendMyGnodeList(spillWorklist, list->head);
-        } else if(COL_moveRelated(list->head) == TRUE) {
-            checkedAppendMyGnodeList(freezeWorklist, list->head);
+    while(emptyNodeSet(INITIAL) == FALSE) {
+        G_node n = nodes[nodeSets[INITIAL].head];
+        if(degree[G_nodeKey(n)] >= K) {
+            toNodeSet(n, SPILL_WORKLIST);
+        } else if(COL_moveRelated(n) == TRUE) {
+            toNodeSet(n, FREEZE_WORKLIST);
         } else {
-            fprintf(fp, "simplify list reg:%d\n", getTempNum(Live_gtemp(list->head)));
-            checkedAppendMyGnodeList(simplifyWorklist, list->head);
+            TR_printf(TR_COLORING, "simplify list reg:%d\n", getTempNum(Live_gtemp(n)));
+            toNodeSet(n, SIMPLIFY_WORKLIST);
         }
     }
 }
 
-void init(int n, Temp_map tPrecolored, Temp_tempList registers) {
+void init(int n, int nm, Temp_map tPrecolored, Temp_tempList registers) {
+    int i = 0;
     precolored       = tPrecolored;
-    initial          = My_Empty_G_nodeList();
-    simplifyWorklist = My_Empty_G_nodeList();
-    freezeWorklist   = My_Empty_G_nodeList();
-    spillWorklist    = My_Empty_G_nodeList();
-    spilledNodes     = My_Empty_G_nodeList();
-    coalescedNodes   = My_Empty_G_nodeList();
-    coloredNodes     = My_Empty_G_nodeList();
-    selectStack      = My_Empty_G_nodeList();
-    coalescedMoves   = My_Empty_Live_moveList(),
-    constrainedMoves = My_Empty_Live_moveList();
-    frozenMoves      = My_Empty_Live_moveList();
-    worklistMoves    = My_Empty_Live_moveList();     // moves possiable for coalescing
-    activeMoves      = My_Empty_Live_moveList();
+    nodes     = checked_malloc(n * sizeof(G_node));
+    nodeLinks = checked_malloc(n * sizeof(struct link));
+    for(i = 0; i < NODE_SETS; ++i)
+        nodeSets[i].head = nodeSets[i].tail = -1;
+    nmoves    = 0;
+    moves     = checked_malloc(nm * sizeof(struct move));
+    moveLinks = checked_malloc(nm * sizeof(struct link));
+    moveMark  = checked_malloc(nm * sizeof(bool));
+    memset(moveMark, 0, nm * sizeof(bool));
+    for(i = 0; i < MOVE_SETS; ++i)
+        moveSets[i].head = moveSets[i].tail = -1;
     adjSet   = My_G_BitMatrix(n);
-    adjList  = G_empty();
-    moveList = G_empty();        // G_node -> Live_moveList
+    adjList  = checked_malloc(n * sizeof(struct adjVector));
+    memset(adjList, 0, n * sizeof(struct adjVector));
+    moveList = checked_malloc(n * sizeof(struct moveVector));
+    memset(moveList, 0, n * sizeof(struct moveVector));
     alias    = G_empty();        // G_node -> G_node
     color    = G_empty();
     colorMap = Temp_layerMap(Temp_empty(), tPrecolored);
 
     // init degree, set all nodes degree to zero
     degree   = (int *)checked_malloc(sizeof(int) * n);
-    int i = 0;
-    for(; i < n; ++i)
+    for(i = 0; i < n; ++i)
         degree[i] = 0;
 
     // get K : the number of registers
@@ -471,91 +555,91 @@ void init(int n, Temp_map tPrecolored, Temp_tempList registers) {
         registers = registers->tail;
     }
 
-    fprintf(fp, "K:%d\n", K);
+    TR_printf(TR_COLORING, "K:%d\n", K);
 }
 
 
 void build(struct Live_graph lg) {
     G_graph ig = lg.graph;
     G_nodeList list = G_nodes(ig);
-    // construct initial list  &  adjSet & alias
+    // put every node in its set: precolored or initial
     for(; list; list = list->tail) {
-        if( isPrecolored(list->head) == FALSE ) {
-            appendMyGnodeList(initial, list->head);
-        }
+        int i = G_nodeKey(list->head);
+        nodes[i] = list->head;
+        nodeLinks[i].set = -1;
+        if(Temp_look(precolored, Live_gtemp(list->head)) == NULL)
+            toNodeSet(list->head, INITIAL);
+        else
+            toNodeSet(list->head, PRECOLORED);
+    }
+    // construct adjSet & adjList & alias
+    for(list = G_nodes(ig); list; list = list->tail) {
         G_nodeList succ = G_succ(list->head);
         for(; succ; succ = succ->tail) {
             COL_addEdge(list->head, succ->head);
         }
         G_enter(alias, list->head, list->head);
-        // degree[G_nodeKey(list->head)] = G_degree(list->head);
-        G_enter(adjList, list->head, cloneFromGnodeList(G_adj(list->head)));
-        // for(; succ; succ = succ->tail)
-        //  {
-        //     My_G_bitMatrixAdd(adjSet, G_nodeKey(succ->head), G_nodeKey(list->head));
-        //     My_G_bitMatrixAdd(adjSet, G_nodeKey(list->head), G_nodeKey(succ->head));
-        // }
     }
 
-    worklistMoves = My_Empty_Live_moveList();
-
-    // cloneFromLiveMoveList(lg.moves);
+    // construct worklistMoves and moveList; the same move may show up
+    // more than once in lg.moves, but only its first copy is kept
     Live_moveList tMoveList = lg.moves;
     for(; tMoveList; tMoveList = tMoveList->tail) {
-        checkedAppendMyLiveMoveList(worklistMoves, tMoveList->src, tMoveList->dst);
-        // fprintf(fp, "%d -> %d\n", getTempNum(Live_gtemp(tMoveList->src)), getTempNum(Live_gtemp(tMoveList->dst)));
-    }
-
-    // construct moveList
-    Live_moveList tmoveList = lg.moves;
-    for(; tmoveList; tmoveList = tmoveList->tail) {
-        My_Live_moveList t1 = G_lookupMoveList(tmoveList->src);
-        checkedAppendMyLiveMoveList(t1, tmoveList->src, tmoveList->dst);
-        // printf("-------------------------------------------%d\n", t1->length);
-        My_Live_moveList t2 = G_lookupMoveList(tmoveList->dst);
-        checkedAppendMyLiveMoveList(t2, tmoveList->src, tmoveList->dst);
-        // printf("-------------------------------------------%d\n", t2->length);
+        struct moveVector *ml = &moveList[G_nodeKey(tMoveList->src)];
+        int i = 0;
+        for(; i < ml->count; ++i) {
+            if(moves[ml->moves[i]].src == tMoveList->src
+                && moves[ml->moves[i]].dst == tMoveList->dst)
+                break;
+        }
+        if(i < ml->count)
+            continue;
+        moves[nmoves].src = tMoveList->src;
+        moves[nmoves].dst = tMoveList->dst;
+        moveLinks[nmoves].set = -1;
+        toMoveSet(nmoves, WORKLIST_MOVES);
+        appendMoveVector(tMoveList->src, nmoves);
+        if(tMoveList->dst != tMoveList->src)
+            appendMoveVector(tMoveList->dst, nmoves);
+        nmoves++;
     }
 }
 
 
 void doWork(){
-    while(!(emptyMyGnodeList(simplifyWorklist) == TRUE 
-            && emptyMyLiveMoveList(worklistMoves) == TRUE 
-            && emptyMyGnodeList(freezeWorklist) == TRUE
-            && emptyMyGnodeList(spillWorklist) == TRUE)) {
-        if(emptyMyGnodeList(simplifyWorklist) != TRUE) {
-            // printf("simplify\n");
+    while(!(emptyNodeSet(SIMPLIFY_WORKLIST) == TRUE 
+            && emptyNodeSet(FREEZE_WORKLIST) == TRUE
+            && emptyNodeSet(SPILL_WORKLIST) == TRUE
+            && moveSets[WORKLIST_MOVES].head < 0)) {
+        if(emptyNodeSet(SIMPLIFY_WORKLIST) != TRUE) {
             COL_simplify();
         }
-        if(emptyMyLiveMoveList(worklistMoves) != TRUE) {
-            // printf("Coalesce\n");
+        if(moveSets[WORKLIST_MOVES].head >= 0) {
             COL_coalesce();
         }
-        if(emptyMyGnodeList(freezeWorklist) != TRUE) {
-            // printf("freeze\n");
+        if(emptyNodeSet(FREEZE_WORKLIST) != TRUE) {
             COL_freeze();
         }
-        if(emptyMyGnodeList(spillWorklist) != TRUE) {
-            // printf("spill\n");
+        if(emptyNodeSet(SPILL_WORKLIST) != TRUE) {
             COL_selectSpill();
         }
     }
 }
 
 struct COL_result COL_color(struct Live_graph lg, Temp_map tPrecolored, Temp_tempList regs) {
-    if(fp == NULL)
-        fp = fopen("my.log", "w");
 	struct COL_result ret = {NULL, NULL};
-    init(G_nodesNumber(lg.graph), tPrecolored, regs);
+    int nm = 0, i;
+    Live_moveList tMoveList = lg.moves;
+    for(; tMoveList; tMoveList = tMoveList->tail)
+        ++nm;
+    init(G_nodesNumber(lg.graph), nm, tPrecolored, regs);
     build(lg);
     COL_makeWorklist();
     doWork();
     COL_assignColors(regs);
 
-    G_nodeList nodes = spilledNodes->head;
-    for(; nodes; nodes = nodes->tail) {
-        ret.spills = Temp_TempList(Live_gtemp(nodes->head), ret.spills);
+    for(i = nodeSets[SPILLED_NODES].head; i >= 0; i = nodeLinks[i].next) {
+        ret.spills = Temp_TempList(Live_gtemp(nodes[i]), ret.spills);
     } 
     ret.coloring = colorMap;
 
@@ -0,0 +1,227 @@
+/*
+ * emitbench.c - Compare the buffered emitter (AS_emitInstrList and
+ *               AS_writePieces) against the old stdio one on a program of
+ *               200000 instructions, the way main.c writes a .s file:
+ *               format every function, then write them out in order.
+ *
+ *               make emitbench && ./emitbench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "util.h"
+#include "symbol.h"
+#include "temp.h"
+#include "assem.h"
+
+#define FUNCTIONS 400
+#define INSTRS 500              /* per function */
+#define TEMPS 300               /* per function */
+
+/* the emitter assem.c had before: expand each instruction's format
+ * string into a stack buffer, then fprintf it.  Instructions no longer
+ * carry format strings, so the bench keeps them on the side. */
+static Temp_temp nthTemp(Temp_tempList list, int i) {
+  return i == 0 ? list->head : nthTemp(list->tail, i-1);
+}
+
+static Temp_label nthLabel(Temp_labelList list, int i) {
+  return i == 0 ? list->head : nthLabel(list->tail, i-1);
+}
+
+static void old_format(char *result, string assem, Temp_tempList dst,
+                       Temp_tempList src, AS_targets jumps, Temp_map m)
+{char *p;
+ int i = 0;
+ for (p = assem; p && *p != '\0'; p++)
+   if (*p == '`') {
+     string s = NULL;
+     switch (*(++p)) {
+     case 's': s = Temp_look(m, nthTemp(src, atoi(++p))); break;
+     case 'd': s = Temp_look(m, nthTemp(dst, atoi(++p))); break;
+     case 'j': s = Temp_labelstring(nthLabel(jumps->labels, atoi(++p))); break;
+     case '`': s = "`"; break;
+     }
+     strcpy(result + i, s);
+     i += strlen(s);
+   }
+   else result[i++] = *p;
+ result[i] = '\0';
+}
+
+static void old_printInstrList(FILE *out, AS_instrList il, string *assem, Temp_map m)
+{char r[200];
+ for (; il; il = il->tail, assem++) {
+   AS_instr i = il->head;
+   switch (i->kind) {
+   case I_OPER:
+     old_format(r, *assem, i->u.OPER.dst, i->u.OPER.src, i->u.OPER.jumps, m);
+     break;
+   case I_LABEL:
+     old_format(r, *assem, NULL, NULL, NULL, m);
+     break;
+   case I_MOVE:
+     old_format(r, *assem, i->u.MOVE.dst, i->u.MOVE.src, NULL, m);
+     break;
+   }
+   fprintf(out, "%s", r);
+ }
+ fprintf(out, "\n");
+}
+
+
+static double seconds(clock_t start)
+{
+ return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* the new emitter: every function into one buffer, then written out */
+static double emitNew(AS_buffer buffer, AS_piece *pieces, AS_instrList *bodies,
+                      Temp_map *maps, int rounds, string file, bool map)
+{clock_t start = clock();
+ int f, k, fd;
+ for (k = 0; k < rounds; k++) {
+   AS_bufferReset(buffer);
+   for (f = 0; f < FUNCTIONS; f++) {
+     pieces[f].buffer = buffer;
+     pieces[f].offset = buffer->length;
+     AS_emitInstrList(buffer, bodies[f], maps[f]);
+     pieces[f].length = buffer->length - pieces[f].offset;
+   }
+   fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0666);
+   if (fd < 0 || !AS_writePieces(fd, pieces, FUNCTIONS, map)) {
+     perror(file);
+     exit(1);
+   }
+   close(fd);
+ }
+ return seconds(start);
+}
+
+static Temp_tempList L(Temp_temp h, Temp_tempList t) {return Temp_TempList(h, t);}
+
+/* a function body shaped like codegen's output: moves, arithmetic,
+ * memory operands, labels and jumps over TEMPS temps, colored with the
+ * six registers the allocator uses; assem gets the old format strings */
+static AS_instrList function(int f, Temp_map coloring, Temp_temp *regs, string *assem)
+{static string colors[] = {"%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi"};
+ Temp_temp temps[TEMPS];
+ Temp_label labels[INSTRS / 10 + 1];
+ AS_instrList il = NULL;
+ char name[32];
+ int i;
+ for (i = 0; i < TEMPS; i++) {
+   temps[i] = Temp_newtemp();
+   Temp_enter(coloring, temps[i], colors[(i * 7 + f) % 6]);
+ }
+ for (i = 0; i <= INSTRS / 10; i++) {
+   sprintf(name, "f%d.L%d", f, i);
+   labels[i] = Temp_namedlabel(name);
+ }
+ for (i = INSTRS - 1; i >= 0; i--) {
+   Temp_temp a = temps[(i * 13) % TEMPS], b = temps[(i * 31 + 5) % TEMPS];
+   AS_instr instr;
+   switch (i % 10) {
+   case 0:
+     sprintf(name, "%s:\n", S_name(labels[i / 10]));
+     assem[i] = String(name);
+     instr = AS_Label(labels[i / 10]);
+     break;
+   case 1: case 4: case 7:
+     assem[i] = "movl `s0, `d0\n";
+     instr = AS_Move(L(a, NULL), L(b, NULL));
+     break;
+   case 2:
+     assem[i] = "addl `s0, `d0\n";
+     instr = AS_Oper(AS_Code(AS_ADDL, AS_Src(0), AS_Dst(0)), L(a, NULL), L(b, L(a, NULL)), NULL);
+     break;
+   case 3:
+     assem[i] = "movl -8(`s0), `d0\n";
+     instr = AS_Oper(AS_Code(AS_MOVL, AS_Disp(-8, 0), AS_Dst(0)), L(a, NULL), L(regs[0], NULL), NULL);
+     break;
+   case 5:
+     assem[i] = "imull `s0, `d0\n";
+     instr = AS_Oper(AS_Code(AS_IMULL, AS_Src(0), AS_Dst(0)), L(a, NULL), L(b, L(a, NULL)), NULL);
+     break;
+   case 6:
+     assem[i] = "cmp `s0, `s1\n";
+     instr = AS_Oper(AS_Code(AS_CMP, AS_Src(0), AS_Src(1)), NULL, L(a, L(b, NULL)), NULL);
+     break;
+   case 8:
+     assem[i] = "jl `j0\n";
+     instr = AS_Oper(AS_Code(AS_JL, AS_Target(0), AS_None()), NULL, NULL,
+                     AS_Targets(Temp_LabelList(labels[i / 10], NULL)));
+     break;
+   default:
+     assem[i] = "movl `s0, 12(`s1)\n";
+     instr = AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Disp(12, 1)), NULL, L(a, L(regs[1], NULL)), NULL);
+     break;
+   }
+   il = AS_InstrList(instr, il);
+ }
+ return il;
+}
+
+int main(void)
+{static string assem[FUNCTIONS][INSTRS];
+ AS_instrList bodies[FUNCTIONS];
+ Temp_map maps[FUNCTIONS];
+ Temp_map registers = Temp_empty();
+ Temp_temp regs[2];
+ AS_buffer buffer = AS_Buffer();
+ AS_piece pieces[FUNCTIONS];
+ string file = "/tmp/emitbench.s";
+ clock_t start;
+ double told, twrite, tmap;
+ size_t oldSize;
+ int f, k, rounds = 5;
+
+ regs[0] = Temp_newtemp();
+ regs[1] = Temp_newtemp();
+ Temp_enter(registers, regs[0], "%ebp");
+ Temp_enter(registers, regs[1], "%esp");
+ Temp_newProgram();
+ for (f = 0; f < FUNCTIONS; f++) {
+   Temp_map coloring = Temp_empty();
+   bodies[f] = function(f, coloring, regs, assem[f]);
+   // layered as doProc layers them: coloring, F_tempMap, Temp_name()
+   maps[f] = Temp_layerMap(Temp_layerMap(coloring, registers), Temp_name());
+ }
+
+ start = clock();
+ for (k = 0; k < rounds; k++) {
+   /* each function into its own memory stream, then copied to the file */
+   char *text[FUNCTIONS];
+   size_t length[FUNCTIONS];
+   FILE *out;
+   for (f = 0; f < FUNCTIONS; f++) {
+     FILE *s = open_memstream(&text[f], &length[f]);
+     old_printInstrList(s, bodies[f], assem[f], maps[f]);
+     fclose(s);
+   }
+   out = fopen(file, "w");
+   for (f = 0, oldSize = 0; f < FUNCTIONS; f++) {
+     fwrite(text[f], 1, length[f], out);
+     oldSize += length[f];
+     free(text[f]);
+   }
+   fclose(out);
+ }
+ told = seconds(start);
+
+ twrite = emitNew(buffer, pieces, bodies, maps, rounds, file, FALSE);
+ tmap = emitNew(buffer, pieces, bodies, maps, rounds, file, TRUE);
+ assert(buffer->length == oldSize);
+ unlink(file);
+
+ printf("%d instructions, %lu bytes, %d rounds\n",
+        FUNCTIONS * INSTRS, (unsigned long)oldSize, rounds);
+ printf("  stdio            %9.4fs\n", told);
+ printf("  buffer + writev  %9.4fs   speedup %5.1fx\n", twrite, twrite > 0 ? told / twrite : 0.0);
+ printf("  buffer + mmap    %9.4fs   speedup %5.1fx\n", tmap, tmap > 0 ? told / tmap : 0.0);
+ return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef ENCODE_H
+#define ENCODE_H
+/*
+ * encode.h - Machine code for a procedure's instructions, for -fobject.
+ *
+ * The code is encoded straight from the allocated instruction list, with
+ * no assembler in between.  Jumps to labels of the same procedure are
+ * resolved as it is encoded; calls, and the addresses of other
+ * procedures and of strings, are left as relocations for the object
+ * writer (or a loader) to fill in.
+ */
+
+/* The machine the code is for: i386, or for --run x86-64 with every
+ * address below 4GB.  The x86-64 code keeps the i386 frame layout, so
+ * push, call, leave and ret, which would move 8 bytes, become moves
+ * through %esp; ret uses %ecx, which calls do not preserve. */
+typedef enum {EN_I386, EN_LOW64} EN_target;
+
+typedef struct {
+  int offset;           /* of the 4 bytes to fill, from the code's start */
+  bool pcRelative;      /* rel32 from the end of those bytes, else absolute */
+  Temp_label sym;       /* NULL for the code's own start */
+} EN_reloc;
+
+/* Append the code for "body" to "code" and its relocations to "relocs",
+ * as EN_reloc records; "m" names the temps, which must all be machine
+ * registers or labels.  The word to be relocated holds its addend.
+ * FALSE, with an error reported, if an instruction cannot be encoded. */
+bool EN_encode(AS_buffer code, AS_buffer relocs, AS_instrList body, Temp_map m,
+               EN_target target);
+
+#endif
@@ -84,5 +84,26 @@ S_table E_base_venv(void) {
 				Ty_TyList(Ty_Int(), NULL), 
 				Ty_Void())
 		  );
+  	S_enter(env, S_Symbol("size"), 
+			E_FunEntry(
+				Tr_outermost(),
+				Temp_namedlabel("size"),
+				Ty_TyList(Ty_String(), NULL), 
+				Ty_Int())
+		  );
+  	S_enter(env, S_Symbol("substring"), 
+			E_FunEntry(
+				Tr_outermost(),
+				Temp_namedlabel("substring"),
+				Ty_TyList(Ty_String(), Ty_TyList(Ty_Int(), Ty_TyList(Ty_Int(), NULL))), 
+				Ty_String())
+		  );
+  	S_enter(env, S_Symbol("concat"), 
+			E_FunEntry(
+				Tr_outermost(),
+				Temp_namedlabel("concat"),
+				Ty_TyList(Ty_String(), Ty_TyList(Ty_String(), NULL)), 
+				Ty_String())
+		  );
   	return env;
 }
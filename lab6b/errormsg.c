@@ -17,6 +17,8 @@ static string fileName = "";
 
 static int lineNum = 1;
 
+static FILE *errors = NULL;    /* where messages go; NULL for stderr */
+
 int EM_tokPos=0;
 
 extern FILE *yyin;
@@ -41,24 +43,37 @@ void EM_error(int pos, char *message,...)
 va_list ap;
  IntList lines = linePos; 
  int num=lineNum;
+ FILE *out = errors ? errors : stderr;
  
   anyErrors=TRUE;
   while (lines && lines->i >= pos) 
        {lines=lines->rest; num--;}
 
-  if (fileName) fprintf(stderr,"%s:",fileName);
-  if (lines) fprintf(stderr,"%d.%d: ", num, pos-lines->i);
+  if (fileName) fprintf(out,"%s:",fileName);
+  if (lines) fprintf(out,"%d.%d: ", num, pos-lines->i);
   va_start(ap,message);
-  vfprintf(stderr, message, ap);
+  vfprintf(out, message, ap);
   va_end(ap);
-  fprintf(stderr,"\n");
+  fprintf(out,"\n");
 }
 
-void EM_reset(string fname)
+void EM_errorsTo(FILE *out)
+{
+ errors = out;
+}
+
+/* Start on the source "in", named "fname" in messages */
+void EM_resetStream(string fname, FILE *in)
 {
  anyErrors=FALSE; fileName=fname; lineNum=1;
  linePos=intList(0,NULL);
- yyin = fopen(fname,"r");
- if (!yyin) {EM_error(0,"cannot open"); exit(1);}
+ yyin = in;
+}
+
+/* Start on the file "fname"; if it cannot be opened, yyin is NULL */
+void EM_reset(string fname)
+{
+ EM_resetStream(fname, fopen(fname,"r"));
+ if (!yyin) EM_error(0,"cannot open");
 }
 
@@ -9,5 +9,9 @@ extern int EM_tokPos;
 void EM_error(int, string,...);
 void EM_impossible(string,...);
 void EM_reset(string filename);
+void EM_resetStream(string filename, FILE *in);
+
+/* Send messages to "out" instead of stderr; NULL goes back to stderr */
+void EM_errorsTo(FILE *out);
 
 #endif
@@ -34,11 +34,9 @@ static void traverseVar(S_table env, int depth, A_var e) {
     switch(e->kind) {
         case A_simpleVar: {
             ES_escapeEntry p = S_look(env, e->u.simple);
-            printf("using : %s\n", S_name(e->u.simple));
             if(p != NULL) {
                 // assert(p != NULL);
                 if(p->depth < depth ) {
-                    printf("mark as escape %s\n", S_name(e->u.simple));
                     *(p->escape) = TRUE;
                 }
             }
@@ -65,7 +63,6 @@ static void traverseDec(S_table env, int depth, A_dec e) {
                 A_fieldList fieldList = fundecList->head->params;
                 S_beginScope(env);
                 for(; fieldList; fieldList = fieldList->tail) {
-                    printf("put in %s\n", S_name(fieldList->head->name));
                     fieldList->head->escape = TRUE;
                     S_enter(env, fieldList->head->name, ES_EscapeEntry(depth + 1, &fieldList->head->escape));    
                 }
@@ -78,7 +75,6 @@ static void traverseDec(S_table env, int depth, A_dec e) {
             traverseExp(env, depth, e->u.var.init);
             ES_escapeEntry p = S_look(env, e->u.var.var);
             if(p == NULL) {
-                printf("put in %s\n", S_name(e->u.var.var));
                 e->u.var.escape = FALSE;
                 S_enter(env, e->u.var.var, ES_EscapeEntry(depth, &e->u.var.escape));
             }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "util.h"
 #include "symbol.h"
 #include "tree.h"
@@ -6,6 +7,7 @@
 #include "errormsg.h"
 #include "table.h"
 #include "flowgraph.h"
+#include "trace.h"
 
 NodeInfo NewNodeInfo(AS_instr instr) {
 	NodeInfo p = checked_malloc(sizeof(*p));
@@ -42,13 +44,13 @@ bool FG_isMove(G_node n) {
 	return info->instr->kind == I_MOVE;
 }
 
-FILE *flowgraph_out = NULL;
+// one line of the flowgraph trace: the instruction, without its newline
+static void showInstr(void *info) {
+	AS_show(TR_out, ((NodeInfo)info)->instr, Temp_layerMap(F_preColored(), Temp_name()));
+}
 
 G_graph FG_AssemFlowGraph(AS_instrList il, F_frame f) {
-	if(flowgraph_out == NULL)
-		flowgraph_out = fopen("my11.txt", "w");
 	G_graph graph = G_Graph();
-	fprintf(flowgraph_out, "------------start------------------------------------------------------------------------------%d\n", G_nodesNumber(graph));
 	S_table labelTable = S_empty();
 	G_node preNode = NULL;
 	AS_instr preInstr = NULL;
@@ -63,11 +65,8 @@ G_graph FG_AssemFlowGraph(AS_instrList il, F_frame f) {
 			S_enter(labelTable, instr->u.LABEL.label, node);
 		} 
 		if(preNode != NULL) {
-			if( !(preInstr->kind == I_OPER && strcmp(preInstr->u.OPER.assem, "jmp `j0\n") == 0))
+			if( !(preInstr->kind == I_OPER && preInstr->u.OPER.code.op == AS_JMP))
 				G_addEdge(preNode, node);
-			else {
-				fprintf(flowgraph_out, "---#######################$$$$$$$$$$$$$@@@@@@@@@@@@$\n");
-			}
 		}
 		preNode = node;
 		preInstr = instr;
@@ -91,9 +90,47 @@ G_graph FG_AssemFlowGraph(AS_instrList il, F_frame f) {
 		}
 	}
 
-	
-	G_show(flowgraph_out, G_nodes(graph), NULL);
-    fprintf(flowgraph_out, "-----finish----------------------------------------\n");
-
+	if(TR_on(TR_FLOWGRAPH)) {
+		fprintf(TR_out, "flowgraph of %s: %d nodes\n", S_name(F_name(f)), G_nodesNumber(graph));
+		G_show(TR_out, G_nodes(graph), showInstr);
+	}
 	return graph;
 }
+
+G_graph FG_BlockGraph(G_graph flow) {
+	int n = G_nodesNumber(flow), i, start;
+	G_node *instrs = checked_malloc(n * sizeof(G_node));
+	G_node *blockOf = checked_malloc(n * sizeof(G_node));
+	G_graph blocks = G_Graph();
+	G_nodeList l;
+
+	// instruction nodes are keyed 0..n-1 in program order
+	for(l = G_nodes(flow); l; l = l->tail)
+		instrs[G_nodeKey(l->head)] = l->head;
+
+	// node i carries on the block of i-1 when the only way into i is
+	// falling through from i-1, and that is the only way out of i-1
+	for(start = 0; start < n; start = i) {
+		FG_block b = checked_malloc(sizeof(*b));
+		G_node bnode;
+		for(i = start + 1; i < n; ++i) {
+			G_nodeList pred = G_pred(instrs[i]), succ = G_succ(instrs[i-1]);
+			if(!(pred && !pred->tail && pred->head == instrs[i-1]
+				 && succ && !succ->tail))
+				break;
+		}
+		b->instrs = instrs + start;
+		b->length = i - start;
+		bnode = G_Node(blocks, b);
+		for(; start < i; ++start)
+			blockOf[start] = bnode;
+	}
+
+	for(i = 0; i < n; ++i) {
+		if(i + 1 < n && blockOf[i] == blockOf[i+1])
+			continue;
+		for(l = G_succ(instrs[i]); l; l = l->tail)
+			G_addEdge(blockOf[i], blockOf[G_nodeKey(l->head)]);
+	}
+	return blocks;
+}
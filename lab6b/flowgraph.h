@@ -22,4 +22,17 @@ Temp_tempList FG_use(G_node n);
 bool FG_isMove(G_node n);
 G_graph FG_AssemFlowGraph(AS_instrList il, F_frame f);
 
+/* A basic block: a run of instruction nodes entered only at the first
+ * and left only from the last. */
+typedef struct FG_block_ *FG_block;
+struct FG_block_ {
+    G_node *instrs;
+    int length;
+};
+
+/* Group the nodes of instruction flow graph "flow" into basic blocks.
+ * Each node of the result carries an FG_block, and its edges follow
+ * the control flow between blocks. */
+G_graph FG_BlockGraph(G_graph flow);
+
 #endif
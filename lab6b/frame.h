@@ -35,7 +35,10 @@ struct F_fragList_ {
 F_fragList F_FragList(F_frag head, F_fragList tail);
 
 
-Temp_map F_tempMap;
+/* names of the temps of the function being compiled by this thread */
+extern __thread Temp_map F_tempMap;
+/* build the register tables, before back ends run in parallel */
+void F_init(void);
 Temp_tempList F_registers();
 Temp_map F_preColored();
 Temp_tempList F_calleeSaves();
@@ -60,7 +63,19 @@ AS_instrList F_procEntryExit2(AS_instrList body); //TODO
 AS_proc F_procEntryExit3(F_frame frame, AS_instrList); //TODO
 
 T_exp F_externalCall(string s, T_expList args);
-void F_string(FILE *out, F_frag);
+
+/* -fgc: every frame stores, at -4(%ebp), a map of the slots that may hold
+ * heap pointers, and a call that may collect stores %ebp in tiger_frame
+ * first, so runtime.c's collector can find its roots.  Calls clobber all
+ * registers, so no pointer stays in a register across a call.  A slot is
+ * taken to hold a pointer unless the front end marks it as a scalar. */
+extern bool F_gc;
+void F_markScalar(F_frame f, F_access a);
+/* the map's assembly, with the slots allocated so far */
+string F_frameMap(F_frame f);
+bool F_allocates(Temp_label fun);
+void F_string(AS_buffer out, F_frag);
+void F_stringData(AS_buffer out, F_frag);
 
 
 #endif
@@ -4,6 +4,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "util.h"
 #include "symbol.h"
 #include "temp.h"
@@ -296,28 +297,111 @@ G_node popMyGnodeList(My_G_nodeList t1) {
 
 /* My_G_bitMatrix functions */
 
+#define PAIRS_INITBITS 10
+
+static unsigned long long pairKey(int t1, int t2) {
+    if(t1 < t2) {
+        int t = t1; t1 = t2; t2 = t;
+    }
+    return ((unsigned long long)(t1 + 1) << 32) | (unsigned)t2;
+}
+
+static int triIndex(int t1, int t2) {
+    if(t1 < t2) {
+        int t = t1; t1 = t2; t2 = t;
+    }
+    return t1 * (t1 + 1) / 2 + t2;
+}
+
+// same Fibonacci hashing as table.c
+static unsigned pairHash(unsigned long long key, int bits) {
+    return (unsigned)((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// slot holding key, or the free slot where it belongs
+static unsigned pairFind(My_G_bitMatrix m, unsigned long long key) {
+    unsigned mask = (1u << m->bits) - 1, i = pairHash(key, m->bits);
+    while(m->pairs[i] && m->pairs[i] != key)
+        i = (i + 1) & mask;
+    return i;
+}
+
+static void pairGrow(My_G_bitMatrix m) {
+    unsigned long long *old = m->pairs;
+    int i, n = 1 << m->bits;
+    m->bits++;
+    m->pairs = checked_malloc(sizeof(*m->pairs) << m->bits);
+    memset(m->pairs, 0, sizeof(*m->pairs) << m->bits);
+    for(i = 0; i < n; ++i)
+        if(old[i])
+            m->pairs[pairFind(m, old[i])] = old[i];
+}
+
 /* create a new bitMatrix, the element number is same to list*/
 My_G_bitMatrix My_G_BitMatrix(int n) {
     My_G_bitMatrix bitMatrix = (My_G_bitMatrix)checked_malloc(sizeof *bitMatrix);
     bitMatrix->num = n;
-    bitMatrix->matrix = (bool *)checked_malloc(n * n * sizeof(bool));
-    int i = 0;
-    for(; i < n*n; ++i) {
-        (bitMatrix->matrix)[i] = FALSE;
+    bitMatrix->tri = NULL;
+    bitMatrix->pairs = NULL;
+    bitMatrix->bits = bitMatrix->npairs = 0;
+    if(n <= MY_G_DENSE_LIMIT) {
+        bitMatrix->tri = Bit_Set(n * (n + 1) / 2);
+    } else {
+        bitMatrix->bits = PAIRS_INITBITS;
+        bitMatrix->pairs = checked_malloc(sizeof(*bitMatrix->pairs) << bitMatrix->bits);
+        memset(bitMatrix->pairs, 0, sizeof(*bitMatrix->pairs) << bitMatrix->bits);
     }
     return bitMatrix;
 }
 
 /* add edge in matrix, add t1->t2*/
 void My_G_bitMatrixAdd(My_G_bitMatrix bitMatrix, int t1, int t2) {
-    (bitMatrix->matrix)[t1*bitMatrix->num+t2] = TRUE;
+    unsigned long long key;
+    unsigned i;
+    assert(t1 >= 0 && t1 < bitMatrix->num && t2 >= 0 && t2 < bitMatrix->num);
+    if(bitMatrix->tri) {
+        Bit_add(bitMatrix->tri, triIndex(t1, t2));
+        return;
+    }
+    if(2 * (bitMatrix->npairs + 1) > (1 << bitMatrix->bits))
+        pairGrow(bitMatrix);
+    key = pairKey(t1, t2);
+    i = pairFind(bitMatrix, key);
+    if(bitMatrix->pairs[i] == 0) {
+        bitMatrix->pairs[i] = key;
+        bitMatrix->npairs++;
+    }
 }
+
 /* remove edge in matrix, remove t1->t2*/
 void My_G_bitMatrixRemove(My_G_bitMatrix bitMatrix, int t1, int t2) {
-    (bitMatrix->matrix)[t1*bitMatrix->num+t2] = FALSE;
+    unsigned mask, i, j, home;
+    if(bitMatrix->tri) {
+        Bit_remove(bitMatrix->tri, triIndex(t1, t2));
+        return;
+    }
+    i = pairFind(bitMatrix, pairKey(t1, t2));
+    if(bitMatrix->pairs[i] == 0)
+        return;
+    bitMatrix->npairs--;
+    // shift the rest of the probe run back into the hole, as table.c does
+    mask = (1u << bitMatrix->bits) - 1;
+    for(j = i;;) {
+        bitMatrix->pairs[i] = 0;
+        do {
+            j = (j + 1) & mask;
+            if(bitMatrix->pairs[j] == 0)
+                return;
+            home = pairHash(bitMatrix->pairs[j], bitMatrix->bits);
+        } while(i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        bitMatrix->pairs[i] = bitMatrix->pairs[j];
+        i = j;
+    }
 }
+
 /* check whether t1 is connect with t2*/
 bool My_G_bitMatrixIsConnect(My_G_bitMatrix bitMatrix, int t1, int t2) {
-    return (bitMatrix->matrix)[t1*bitMatrix->num+t2] == TRUE;
+    if(bitMatrix->tri)
+        return Bit_member(bitMatrix->tri, triIndex(t1, t2));
+    return bitMatrix->pairs[pairFind(bitMatrix, pairKey(t1, t2))] != 0;
 }
-
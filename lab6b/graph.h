@@ -3,6 +3,7 @@
 /*
  * graph.h - Abstract Data Type (ADT) for directed graphs
  */
+#include "bitset.h"
 
 typedef struct G_graph_ *G_graph;  /* The "graph" type */
 typedef struct G_node_ *G_node;    /* The "node" type */
@@ -102,12 +103,18 @@ void G_enter(G_table t, G_node node, void *value);
 void *G_look(G_table t, G_node node);
 
 
-// TODO based on int
-/* bit matrix  */
+/* bit matrix
+ * Edges are undirected, so only the lower triangle is kept, one bit per
+ * pair: adding t1->t2 also makes t2 connect with t1.  Past
+ * MY_G_DENSE_LIMIT nodes the triangle itself gets too big (n*n/16 bytes)
+ * and the edges go into a hash set of node pairs instead. */
+#define MY_G_DENSE_LIMIT 8192
 typedef struct My_G_bitMatrix_ *My_G_bitMatrix;
 struct My_G_bitMatrix_ {
     int num;
-    bool *matrix;
+    Bit_set tri;                /* dense: pair (i,j), j <= i, is bit i*(i+1)/2+j */
+    unsigned long long *pairs;  /* sparse: open addressing, 0 marks a free slot */
+    int bits, npairs;           /* sparse: 1 << bits slots */
 };
 /* create a new bitMatrix, the element number is same to list*/
 My_G_bitMatrix My_G_BitMatrix(int n);
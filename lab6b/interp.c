@@ -0,0 +1,631 @@
+/*
+ * interp.c - Running a program from its canonical IR trees.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "util.h"
+#include "symbol.h"
+#include "table.h"
+#include "temp.h"
+#include "tree.h"
+#include "assem.h"
+#include "frame.h"
+#include "errormsg.h"
+#include "interp.h"
+
+#define STACKSIZE (8 << 20)
+#define HEAPSIZE (256 << 20)
+#define MEMSIZE (HEAPSIZE + STACKSIZE)
+#define DATASTART 4096  /* addresses below it are never valid */
+
+/* A procedure's statements as an array, with the index of each label's
+ * statement.  temps maps each temp in the statements to an int *: a slot
+ * of the activation if it is >= 0, else the machine register -1-it. */
+struct function {
+  F_frame frame;
+  T_stm *stms;
+  int n, nlocals;
+  TAB_table labels, temps;
+};
+
+struct IN_program_ {
+  AS_buffer data;
+  TAB_table functions;          /* label -> struct function * */
+  TAB_table symbols;            /* label -> int *, its place in data */
+  TAB_table runtime;            /* label -> int *, its index in runtime[] */
+};
+
+/* the machine registers, as temps to int * and as values while running */
+static TAB_table machine;
+static int nregs;
+static int regs[16];
+static int fpReg, spReg, rvReg;
+
+static int *newInt(int v)
+{int *p = checked_malloc(sizeof(*p));
+ *p = v;
+ return p;
+}
+
+static void addRegister(Temp_temp t)
+{
+ if (!TAB_look(machine, t)) {
+   assert(nregs < (int)(sizeof(regs) / sizeof(regs[0])));
+   TAB_enter(machine, t, newInt(-1 - nregs++));
+ }
+}
+
+IN_program IN_Program(void)
+{U_region prev = U_regionSwitch(U_permanent());
+ IN_program p = checked_malloc(sizeof(*p));
+ Temp_tempList r;
+ p->data = AS_Buffer();
+ p->functions = p->symbols = p->runtime = NULL;
+ if (!machine) {
+   machine = TAB_empty();
+   for (r = F_registers(); r; r = r->tail)
+     addRegister(r->head);
+   addRegister(F_FP());
+   addRegister(F_SP());
+   fpReg = -1 - *(int *)TAB_look(machine, F_FP());
+   spReg = -1 - *(int *)TAB_look(machine, F_SP());
+   rvReg = -1 - *(int *)TAB_look(machine, F_RV());
+ }
+ U_regionSwitch(prev);
+ return p;
+}
+
+/* the tables live in the caller's region, which lasts for one file */
+void IN_reset(IN_program p)
+{
+ AS_bufferReset(p->data);
+ p->functions = TAB_empty();
+ p->symbols = TAB_empty();
+ p->runtime = TAB_empty();
+}
+
+static void findTemps(struct function *f, T_exp e);
+
+static void findTemp(struct function *f, Temp_temp t)
+{
+ if (!TAB_look(f->temps, t)) {
+   int *m = TAB_look(machine, t);
+   TAB_enter(f->temps, t, m ? m : newInt(f->nlocals++));
+ }
+}
+
+static void findTempsList(struct function *f, T_expList l)
+{
+ for (; l; l = l->tail)
+   findTemps(f, l->head);
+}
+
+static void findTemps(struct function *f, T_exp e)
+{
+ switch (e->kind) {
+ case T_BINOP:
+   findTemps(f, e->u.BINOP.left);
+   findTemps(f, e->u.BINOP.right);
+   break;
+ case T_MEM:
+   findTemps(f, e->u.MEM);
+   break;
+ case T_TEMP:
+   findTemp(f, e->u.TEMP);
+   break;
+ case T_CALL:
+   findTemps(f, e->u.CALL.fun);
+   findTempsList(f, e->u.CALL.args);
+   break;
+ case T_ESEQ:
+   assert(!"ESEQ in a canonical tree");
+ default:
+   break;
+ }
+}
+
+void IN_function(IN_program p, F_frame frame, T_stmList stms)
+{struct function *f = checked_malloc(sizeof(*f));
+ T_stmList l;
+ int i;
+ f->frame = frame;
+ for (f->n = 0, l = stms; l; l = l->tail)
+   f->n++;
+ f->stms = checked_malloc(f->n * sizeof(T_stm));
+ f->nlocals = 0;
+ f->labels = TAB_empty();
+ f->temps = TAB_empty();
+ for (i = 0, l = stms; l; l = l->tail, i++) {
+   T_stm s = f->stms[i] = l->head;
+   switch (s->kind) {
+   case T_LABEL:
+     TAB_enter(f->labels, s->u.LABEL, newInt(i));
+     break;
+   case T_JUMP:
+     break;
+   case T_CJUMP:
+     findTemps(f, s->u.CJUMP.left);
+     findTemps(f, s->u.CJUMP.right);
+     break;
+   case T_MOVE:
+     findTemps(f, s->u.MOVE.dst);
+     findTemps(f, s->u.MOVE.src);
+     break;
+   case T_EXP:
+     findTemps(f, s->u.EXP);
+     break;
+   default:
+     assert(!"SEQ in a canonical statement list");
+   }
+ }
+ TAB_enter(p->functions, F_name(frame), f);
+}
+
+void IN_data(IN_program p, Temp_label name, char *bytes, size_t length)
+{
+ while (p->data->length % 4)
+   AS_write(p->data, "", 1);
+ TAB_enter(p->symbols, name, newInt(p->data->length));
+ AS_write(p->data, bytes, length);
+}
+
+/* The memory, and the state of a run.  Any error in the program ends
+ * the run with a longjmp to IN_run. */
+static unsigned char *mem;
+static unsigned heapLimit, consts, empty;
+
+/* tiger_avail and tiger_limit, which the compiled code bumps records and
+ * arrays out of, are the two words at "bump" */
+static unsigned bump;
+static jmp_buf escape;
+static IN_program program;
+
+static void stop(int status)
+{
+ fflush(stdout);
+ longjmp(escape, status ? status : 1);
+}
+
+static void fault(string format, ...)
+{char message[256];
+ va_list ap;
+ va_start(ap, format);
+ vsnprintf(message, sizeof(message), format, ap);
+ va_end(ap);
+ fflush(stdout);
+ EM_error(0, "%s", message);
+ longjmp(escape, -1);
+}
+
+static int load(unsigned a)
+{int v;
+ if (a < DATASTART || a > MEMSIZE - 4)
+   fault("memory fault at address %#x", a);
+ memcpy(&v, mem + a, 4);
+ return v;
+}
+
+static void store(unsigned a, int v)
+{
+ if (a < DATASTART || a > MEMSIZE - 4)
+   fault("memory fault at address %#x", a);
+ memcpy(mem + a, &v, 4);
+}
+
+/* The runtime, as runtime.c has it, on the simulated memory: a string
+ * is the address of its length, which its characters follow. */
+static unsigned alloc(int n)
+{unsigned p = load(bump);
+ n = (n + 7) & ~7;
+ if (n < 0 || (unsigned)n > heapLimit - p) {
+   printf("out of memory\n");
+   stop(1);
+ }
+ store(bump, p + n);
+ return p;
+}
+
+static unsigned char *chars(unsigned s, int *length)
+{
+ *length = load(s);
+ if (*length < 0 || (unsigned)*length > MEMSIZE - 4 - s)
+   fault("memory fault at address %#x", s);
+ return mem + s + 4;
+}
+
+static int tiger_initArray(int *a)
+{int i, size = a[0];
+ unsigned p = alloc(size*sizeof(int));
+ for(i=0;i<size;i++) store(p+4*i, a[1]);
+ return p;
+}
+
+static int tiger_allocRecord(int *a)
+{int i, size = a[0];
+ unsigned p = alloc(size);
+ for(i=0;i<size;i+=sizeof(int)) store(p+i, 0);
+ return p;
+}
+
+static int tiger_stringEqual(int *a)
+{int i, n, m;
+ unsigned char *s, *t;
+ if (a[0]==a[1]) return 1;
+ s = chars(a[0], &n);
+ t = chars(a[1], &m);
+ if (n!=m) return 0;
+ for(i=0;i<n;i++) if (s[i]!=t[i]) return 0;
+ return 1;
+}
+
+static int tiger_flush(int *a)
+{
+ fflush(stdout);
+ return 0;
+}
+
+static int tiger_print(int *a)
+{int i, n;
+ unsigned char *p = chars(a[0], &n);
+ for(i=0;i<n;i++,p++) putchar(*p);
+ return tiger_flush(a);
+}
+
+static int tiger_printi(int *a)
+{
+ printf("%d", a[0]);
+ return tiger_flush(a);
+}
+
+static int tiger_ord(int *a)
+{int n;
+ unsigned char *s = chars(a[0], &n);
+ if (n==0) return -1;
+ else return s[0];
+}
+
+static int tiger_chr(int *a)
+{
+ if (a[0]<0 || a[0]>=256)
+   {printf("chr(%d) out of range\n",a[0]); stop(1);}
+ return consts+8*a[0];
+}
+
+static int tiger_size(int *a)
+{
+ return load(a[0]);
+}
+
+static int tiger_substring(int *a)
+{int n, first=a[1], count=a[2];
+ unsigned char *s = chars(a[0], &n);
+ if (first<0 || first+count>n)
+   {printf("substring([%d],%d,%d) out of range\n",n,first,count);
+    stop(1);}
+ if (count==1) return consts+8*s[first];
+ {unsigned t = alloc(sizeof(int)+count);
+  store(t, count);
+  memcpy(mem+t+4, s+first, count);
+  return t;
+ }
+}
+
+static int tiger_concat(int *a)
+{int n, m;
+ unsigned char *s = chars(a[0], &n), *t = chars(a[1], &m);
+ if (n==0) return a[1];
+ else if (m==0) return a[0];
+ else {unsigned r = alloc(sizeof(int)+n+m);
+       store(r, n+m);
+       memcpy(mem+r+4, s, n);
+       memcpy(mem+r+4+n, t, m);
+       return r;
+     }
+}
+
+static int tiger_not(int *a)
+{ return !a[0];
+}
+
+static int tiger_getchar(int *a)
+{int i=getc(stdin);
+ if (i==EOF) return empty;
+ else return consts+8*i;
+}
+
+static struct {string name; int nargs; int (*f)(int *);} runtime[] = {
+  {"initArray", 2, tiger_initArray}, {"allocRecord", 1, tiger_allocRecord},
+  {"stringEqual", 2, tiger_stringEqual}, {"flush", 0, tiger_flush},
+  {"print", 1, tiger_print}, {"printi", 1, tiger_printi}, {"ord", 1, tiger_ord},
+  {"chr", 1, tiger_chr}, {"size", 1, tiger_size},
+  {"substring", 3, tiger_substring}, {"concat", 2, tiger_concat},
+  {"not", 1, tiger_not}, {"getchar", 0, tiger_getchar}
+};
+
+#define RUNTIME ((int)(sizeof(runtime) / sizeof(runtime[0])))
+
+/* The activations, innermost last.  Canonical trees call only from the
+ * top of a statement, so a call pushes an activation and the loop in
+ * execute goes on with it; no C recursion is needed.  "base" is where
+ * its temps start in "slots"; "result" is the temp of the caller the
+ * value goes to, if any. */
+struct activation {
+  struct function *f;
+  int pc, base;
+  unsigned fp, sp;              /* the caller's */
+  T_exp result;
+};
+
+static struct activation *acts;
+static int nacts, maxacts;
+static int *slots;
+static int nslots, maxslots;
+
+/* the innermost activation's function and temps */
+static struct function *current;
+static int *locals;
+
+static int *temp(Temp_temp t)
+{int i = *(int *)TAB_look(current->temps, t);
+ return i >= 0 ? &locals[i] : &regs[-1 - i];
+}
+
+static unsigned address(Temp_label name)
+{int *at = TAB_look(program->symbols, name);
+ if (!at && name == Temp_namedlabel("tiger_avail"))
+   return bump;
+ if (!at && name == Temp_namedlabel("tiger_limit"))
+   return bump + 4;
+ if (!at)
+   fault("no data at %s", S_name(name));
+ return DATASTART + *at;
+}
+
+static int eval(T_exp e)
+{
+ switch (e->kind) {
+ case T_CONST:
+   return e->u.CONST;
+ case T_TEMP:
+   return *temp(e->u.TEMP);
+ case T_MEM:
+   return load(eval(e->u.MEM));
+ case T_NAME:
+   return address(e->u.NAME);
+ case T_BINOP: {
+   int a = eval(e->u.BINOP.left), b = eval(e->u.BINOP.right);
+   switch (e->u.BINOP.op) {
+   case T_plus: return (unsigned)a + (unsigned)b;
+   case T_minus: return (unsigned)a - (unsigned)b;
+   case T_mul: return (unsigned)a * (unsigned)b;
+   case T_div:
+     if (b == 0 || (a == (int)0x80000000 && b == -1))
+       fault("division overflow in %s", S_name(F_name(current->frame)));
+     return a / b;
+   case T_and: return a & b;
+   case T_or: return a | b;
+   case T_lshift: return (unsigned)a << (b & 31);
+   case T_rshift: return (unsigned)a >> (b & 31);
+   case T_arshift: return a >> (b & 31);
+   case T_xor: return a ^ b;
+   }
+   break;
+ }
+ default:
+   break;
+ }
+ assert(!"not an expression of a canonical tree");
+ return 0;
+}
+
+static bool test(T_relOp op, int a, int b)
+{
+ switch (op) {
+ case T_eq: return a == b;
+ case T_ne: return a != b;
+ case T_lt: return a < b;
+ case T_gt: return a > b;
+ case T_le: return a <= b;
+ case T_ge: return a >= b;
+ case T_ult: return (unsigned)a < (unsigned)b;
+ case T_ule: return (unsigned)a <= (unsigned)b;
+ case T_ugt: return (unsigned)a > (unsigned)b;
+ case T_uge: return (unsigned)a >= (unsigned)b;
+ }
+ return FALSE;
+}
+
+static void resume(void)
+{struct activation *a = &acts[nacts - 1];
+ current = a->f;
+ locals = slots + a->base;
+}
+
+/* Enter "f" with "args", as the compiled code would: the arguments
+ * pushed last to first, a return address and the caller's frame pointer
+ * saved, then the frame's locals reserved below. */
+static void enter(struct function *f, int *args, int n, T_exp result)
+{struct activation *a;
+ unsigned sp = regs[spReg];
+ int size = (4 - F_frameMaxOffset(f->frame)) * F_wordSize + n * F_wordSize;
+ int i;
+ if (sp < heapLimit + size)
+   fault("stack overflow in %s", S_name(F_name(f->frame)));
+ for (i = n - 1; i >= 0; i--)
+   store(sp -= 4, args[i]);
+ store(sp -= 4, 0);
+ store(sp -= 4, regs[fpReg]);
+ if (nacts == maxacts) {
+   maxacts = maxacts ? 2 * maxacts : 256;
+   acts = realloc(acts, maxacts * sizeof(*acts));
+ }
+ while (nslots + f->nlocals > maxslots) {
+   maxslots = maxslots ? 2 * maxslots : 4096;
+   slots = realloc(slots, maxslots * sizeof(*slots));
+ }
+ if (!acts || !slots) {
+   EM_error(0, "out of memory to interpret in");
+   exit(1);
+ }
+ a = &acts[nacts++];
+ a->f = f;
+ a->pc = 0;
+ a->base = nslots;
+ a->fp = regs[fpReg];
+ a->sp = regs[spReg];
+ a->result = result;
+ memset(slots + nslots, 0, f->nlocals * sizeof(*slots));
+ nslots += f->nlocals;
+ regs[fpReg] = sp;
+ regs[spReg] = sp + (F_frameMaxOffset(f->frame) - 3) * F_wordSize;
+ resume();
+}
+
+/* Return from the innermost activation, with the value in %eax */
+static void leave(void)
+{struct activation *a = &acts[--nacts];
+ regs[fpReg] = a->fp;
+ regs[spReg] = a->sp;
+ nslots = a->base;
+ if (nacts > 0) {
+   resume();
+   if (a->result)
+     *temp(a->result->u.TEMP) = regs[rvReg];
+ }
+}
+
+static void call(T_exp e, T_exp result)
+{Temp_label name = e->u.CALL.fun->u.NAME;
+ struct function *f;
+ T_expList l;
+ int n = 0, *i;
+ assert(e->u.CALL.fun->kind == T_NAME);
+ for (l = e->u.CALL.args; l; l = l->tail)
+   n++;
+ int args[n + 1];
+ for (n = 0, l = e->u.CALL.args; l; l = l->tail)
+   args[n++] = eval(l->head);
+ if ((f = TAB_look(program->functions, name))) {
+   enter(f, args, n, result);
+   return;
+ }
+ if (!(i = TAB_look(program->runtime, name))) {
+   int k;
+   for (k = 0; k < RUNTIME; k++)
+     if (!strcmp(S_name(name), runtime[k].name))
+       break;
+   if (k == RUNTIME || runtime[k].nargs != n)
+     fault("undefined procedure %s", S_name(name));
+   TAB_enter(program->runtime, name, i = newInt(k));
+ }
+ regs[rvReg] = runtime[*i].f(args);
+ if (result)
+   *temp(result->u.TEMP) = regs[rvReg];
+}
+
+static void jump(Temp_label l)
+{
+ acts[nacts - 1].pc = *(int *)TAB_look(current->labels, l);
+}
+
+static void execute(void)
+{
+ while (nacts > 0) {
+   struct activation *a = &acts[nacts - 1];
+   T_stm s;
+   if (a->pc == current->n) {
+     leave();
+     continue;
+   }
+   s = current->stms[a->pc++];
+   switch (s->kind) {
+   case T_LABEL:
+     break;
+   case T_JUMP:
+     /* as in codegen, the target is the first of the jumps */
+     jump(s->u.JUMP.jumps->head);
+     break;
+   case T_CJUMP: {
+     T_exp left = s->u.CJUMP.left, right = s->u.CJUMP.right;
+     bool taken;
+     /* as in codegen, a comparison with a string literal is stringEqual */
+     if (left->kind == T_NAME || right->kind == T_NAME) {
+       int args[2];
+       args[0] = eval(left);
+       args[1] = eval(right);
+       taken = tiger_stringEqual(args) == 1;
+     } else
+       taken = test(s->u.CJUMP.op, eval(left), eval(right));
+     jump(taken ? s->u.CJUMP.true : s->u.CJUMP.false);
+     break;
+   }
+   case T_MOVE: {
+     T_exp dst = s->u.MOVE.dst, src = s->u.MOVE.src;
+     if (src->kind == T_CALL)
+       call(src, dst);
+     else if (dst->kind == T_TEMP)
+       *temp(dst->u.TEMP) = eval(src);
+     else {
+       unsigned at = eval(dst->u.MEM);
+       store(at, eval(src));
+     }
+     break;
+   }
+   case T_EXP:
+     if (s->u.EXP->kind == T_CALL)
+       call(s->u.EXP, NULL);
+     else
+       eval(s->u.EXP);
+     break;
+   default:
+     assert(!"SEQ in a canonical statement list");
+   }
+ }
+}
+
+int IN_run(IN_program p)
+{struct function *entry = TAB_look(p->functions, Temp_namedlabel("tigermain"));
+ volatile int status;
+ unsigned i;
+
+ if (!entry) {
+   EM_error(0, "no tigermain to run");
+   return -1;
+ }
+ if (!mem && !(mem = calloc(MEMSIZE, 1))) {
+   EM_error(0, "cannot allocate memory to interpret in");
+   return -1;
+ }
+ if (p->data->length > HEAPSIZE / 2) {
+   EM_error(0, "too much data to interpret");
+   return -1;
+ }
+ program = p;
+ memcpy(mem + DATASTART, p->data->text, p->data->length);
+ bump = (DATASTART + p->data->length + 7) & ~7;
+ heapLimit = HEAPSIZE;
+ store(bump, bump + 8);
+ store(bump + 4, heapLimit);
+ consts = alloc(256 * 8);
+ for (i = 0; i < 256; i++) {
+   store(consts + 8*i, 1);
+   mem[consts + 8*i + 4] = i;
+ }
+ empty = alloc(8);
+ store(empty, 0);
+
+ memset(regs, 0, sizeof(regs));
+ regs[spReg] = MEMSIZE;
+ nacts = nslots = 0;
+ if (!(status = setjmp(escape))) {
+   enter(entry, (int[]){0}, 1, NULL);
+   execute();
+ }
+ fflush(stdout);
+ program = NULL;
+ return status;
+}
@@ -0,0 +1,36 @@
+#ifndef INTERP_H
+#define INTERP_H
+/*
+ * interp.h - Running a program from its canonical IR trees, for
+ * --interpret.
+ *
+ * Each procedure is given as the statement list C_traceSchedule made of
+ * its body (after F_procEntryExit1), with no instruction selection or
+ * register allocation.  IN_run executes the statements in a simulated
+ * 32-bit memory that holds the strings, a heap and a stack; frames are
+ * laid out as the compiled code lays them out, so F_Exp's offsets from
+ * the frame pointer and the static links work unchanged.  Calls outside
+ * the program go to this module's own copy of runtime.c.
+ */
+
+typedef struct IN_program_ *IN_program;
+
+/* An empty program, kept (with its memory) for the life of the compiler */
+IN_program IN_Program(void);
+
+/* Empty "p" for the next file */
+void IN_reset(IN_program p);
+
+/* Add the procedure of "frame", whose body is "stms"; the trees must
+ * last until IN_run returns */
+void IN_function(IN_program p, F_frame frame, T_stmList stms);
+
+/* As OBJ_data */
+void IN_data(IN_program p, Temp_label name, char *bytes, size_t length);
+
+/* Run "p" from tigermain, reading stdin and writing stdout.  Its exit
+ * status: 0, or what the runtime exits with; -1, with an error
+ * reported, if it cannot be run or goes wrong as it runs. */
+int IN_run(IN_program p);
+
+#endif
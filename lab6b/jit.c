@@ -0,0 +1,369 @@
+/*
+ * jit.c - Running compiled programs in process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "util.h"
+#include "symbol.h"
+#include "table.h"
+#include "temp.h"
+#include "assem.h"
+#include "errormsg.h"
+#include "encode.h"
+#include "jit.h"
+
+#define STACKSIZE (8 << 20)
+#define HEAPSIZE (256 << 20)
+
+enum {TEXT, DATA};
+
+/* where a symbol of the program is, in its text or data */
+struct place {int section; unsigned value;};
+
+/* "self": the start of the function the relocation is in */
+struct reloc {unsigned offset, self; Temp_label sym; bool pcRelative;};
+
+struct JIT_program_ {
+  AS_buffer text, data, relocs;
+  TAB_table symbols;            /* label -> struct place * */
+};
+
+JIT_program JIT_Program(void)
+{JIT_program p = U_regionAlloc(U_permanent(), sizeof(*p));
+ p->text = AS_Buffer();
+ p->data = AS_Buffer();
+ p->relocs = AS_Buffer();
+ p->symbols = NULL;
+ return p;
+}
+
+/* the table lives in the caller's region, which lasts for one file */
+void JIT_reset(JIT_program p)
+{
+ AS_bufferReset(p->text);
+ AS_bufferReset(p->data);
+ AS_bufferReset(p->relocs);
+ p->symbols = TAB_empty();
+}
+
+static void define(JIT_program p, Temp_label name, int section, unsigned value)
+{struct place *at = checked_malloc(sizeof(*at));
+ at->section = section;
+ at->value = value;
+ TAB_enter(p->symbols, name, at);
+}
+
+void JIT_function(JIT_program p, Temp_label name, char *code, size_t length,
+                  EN_reloc *relocs, int nrelocs)
+{struct reloc r;
+ int i;
+ define(p, name, TEXT, p->text->length);
+ for (i = 0; i < nrelocs; i++) {
+   r.offset = p->text->length + relocs[i].offset;
+   r.self = p->text->length;
+   r.sym = relocs[i].sym;
+   r.pcRelative = relocs[i].pcRelative;
+   AS_write(p->relocs, (char *)&r, sizeof(r));
+ }
+ AS_write(p->text, code, length);
+}
+
+void JIT_data(JIT_program p, Temp_label name, char *bytes, size_t length)
+{
+ while (p->data->length % 4)
+   AS_write(p->data, "", 1);
+ define(p, name, DATA, p->data->length);
+ AS_write(p->data, bytes, length);
+}
+
+#if defined(__x86_64__) && defined(MAP_32BIT)
+
+/* The runtime, as runtime.c has it, but allocating below 4GB.  A call
+ * to exit comes back to JIT_run instead.  tiger_avail and tiger_limit,
+ * which the compiled code bumps records and arrays out of, are the
+ * heap's first two words. */
+static char *heap;
+static unsigned *bump;
+static jmp_buf escape;
+
+static void stop(int status)
+{
+ fflush(stdout);
+ longjmp(escape, status ? status : 1);
+}
+
+static void *alloc(int n)
+{void *p = (void *)(unsigned long)bump[0];
+ n = (n + 7) & ~7;
+ if (n < 0 || (unsigned)n > bump[1] - bump[0]) {
+   printf("out of memory\n");
+   stop(1);
+ }
+ bump[0] += n;
+ return p;
+}
+
+struct string {int length; unsigned char chars[1];};
+
+static struct string *consts, *empty;
+
+static int *tiger_initArray(int size, int init)
+{int i;
+ int *a = alloc(size*sizeof(int));
+ for(i=0;i<size;i++) a[i]=init;
+ return a;
+}
+
+static int *tiger_allocRecord(int size)
+{int i;
+ int *p, *a;
+ p = a = alloc(size);
+ for(i=0;i<size;i+=sizeof(int)) *p++ = 0;
+ return a;
+}
+
+static int tiger_stringEqual(struct string *s, struct string *t)
+{int i;
+ if (s==t) return 1;
+ if (s->length!=t->length) return 0;
+ for(i=0;i<s->length;i++) if (s->chars[i]!=t->chars[i]) return 0;
+ return 1;
+}
+
+static void tiger_flush(void)
+{
+ fflush(stdout);
+}
+
+static void tiger_print(struct string *s)
+{int i; unsigned char *p=s->chars;
+ for(i=0;i<s->length;i++,p++) putchar(*p);
+ tiger_flush();
+}
+
+static void tiger_printi(int k)
+{
+ printf("%d", k);
+ tiger_flush();
+}
+
+static int tiger_ord(struct string *s)
+{
+ if (s->length==0) return -1;
+ else return s->chars[0];
+}
+
+static struct string *tiger_chr(int i)
+{
+ if (i<0 || i>=256)
+   {printf("chr(%d) out of range\n",i); stop(1);}
+ return consts+i;
+}
+
+static int tiger_size(struct string *s)
+{
+ return s->length;
+}
+
+static struct string *tiger_substring(struct string *s, int first, int n)
+{
+ if (first<0 || first+n>s->length)
+   {printf("substring([%d],%d,%d) out of range\n",s->length,first,n);
+    stop(1);}
+ if (n==1) return consts+s->chars[first];
+ {struct string *t = alloc(sizeof(int)+n);
+  int i;
+  t->length=n;
+  for(i=0;i<n;i++) t->chars[i]=s->chars[first+i];
+  return t;
+ }
+}
+
+static struct string *tiger_concat(struct string *a, struct string *b)
+{
+ if (a->length==0) return b;
+ else if (b->length==0) return a;
+ else {int i, n=a->length+b->length;
+       struct string *t = alloc(sizeof(int)+n);
+       t->length=n;
+       for (i=0;i<a->length;i++)
+         t->chars[i]=a->chars[i];
+       for(i=0;i<b->length;i++)
+         t->chars[i+a->length]=b->chars[i];
+       return t;
+     }
+}
+
+static int tiger_not(int i)
+{ return !i;
+}
+
+static struct string *tiger_getchar(void)
+{int i=getc(stdin);
+ if (i==EOF) return empty;
+ else return consts+i;
+}
+
+static struct {string name; void *f;} runtime[] = {
+  {"initArray", tiger_initArray}, {"allocRecord", tiger_allocRecord},
+  {"stringEqual", tiger_stringEqual}, {"flush", tiger_flush},
+  {"print", tiger_print}, {"printi", tiger_printi}, {"ord", tiger_ord},
+  {"chr", tiger_chr}, {"size", tiger_size}, {"substring", tiger_substring},
+  {"concat", tiger_concat}, {"not", tiger_not}, {"getchar", tiger_getchar}
+};
+
+#define RUNTIME ((int)(sizeof(runtime) / sizeof(runtime[0])))
+
+/* Between Tiger code and C.  jitEnter(entry, stack, stub) saves C's
+ * registers and calls entry(0) on the Tiger stack, with "stub", which
+ * jumps to jitReturn, as its return address.  A call to the runtime goes
+ * to a thunk, which jumps to jitCall with the C function in %rax;
+ * jitCall passes the call's first three words to it on C's stack and
+ * keeps %esi and %edi, which Tiger code expects preserved. */
+static unsigned long nativeSp __attribute__((used));
+
+__asm__(
+".text\n"
+"jitEnter:\n"
+"  push %rbx\n  push %rbp\n  push %r12\n  push %r13\n  push %r14\n  push %r15\n"
+"  sub $8, %rsp\n"
+"  mov %rsp, nativeSp(%rip)\n"
+"  mov %rsi, %rsp\n"
+"  movl $0, -4(%rsp)\n"
+"  movl %edx, -8(%rsp)\n"
+"  sub $8, %rsp\n"
+"  jmp *%rdi\n"
+"jitReturn:\n"
+"  mov nativeSp(%rip), %rsp\n"
+"  add $8, %rsp\n"
+"  pop %r15\n  pop %r14\n  pop %r13\n  pop %r12\n  pop %rbp\n  pop %rbx\n"
+"  ret\n"
+"jitCall:\n"
+"  mov %rsp, %r12\n  mov %rsi, %r13\n  mov %rdi, %r14\n"
+"  movl 4(%rsp), %edi\n  movl 8(%rsp), %esi\n  movl 12(%rsp), %edx\n"
+"  mov nativeSp(%rip), %rsp\n"
+"  call *%rax\n"
+"  mov %r12, %rsp\n  mov %r13, %rsi\n  mov %r14, %rdi\n"
+"  movl (%rsp), %ecx\n"
+"  lea 4(%rsp), %rsp\n"
+"  jmp *%rcx\n"
+);
+
+void jitEnter(void *entry, void *stack, void *stub);
+void jitReturn(void);
+void jitCall(void);
+
+#define THUNKSIZE 23    /* movabs $f, %rax; movabs $jitCall, %r11; jmp *%r11 */
+#define STUBSIZE 12     /* movabs $jitReturn, %rcx; jmp *%rcx */
+
+static char *put64(char *p, void *v)
+{
+ memcpy(p, &v, 8);
+ return p + 8;
+}
+
+static char *low(size_t size)
+{char *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+ return p == MAP_FAILED ? NULL : p;
+}
+
+static char *address(JIT_program p, char *base, size_t dataStart, Temp_label sym)
+{struct place *at = TAB_look(p->symbols, sym);
+ int i;
+ if (at)
+   return base + (at->section == TEXT ? 0 : dataStart) + at->value;
+ if (sym == Temp_namedlabel("tiger_avail"))
+   return (char *)&bump[0];
+ if (sym == Temp_namedlabel("tiger_limit"))
+   return (char *)&bump[1];
+ for (i = 0; i < RUNTIME; i++)
+   if (!strcmp(S_name(sym), runtime[i].name))
+     return base + p->text->length + i * THUNKSIZE;
+ return NULL;
+}
+
+int JIT_run(JIT_program p)
+{static char *stack = NULL;
+ size_t page = 4096, codeSize, dataStart, size, i;
+ char *base, *q, *entry;
+ int status;
+
+ if (!stack) {
+   stack = low(STACKSIZE);
+   heap = low(HEAPSIZE);
+   if (!stack || !heap) {
+     EM_error(0, "cannot map memory below 4GB to run in");
+     return -1;
+   }
+   bump = (unsigned *)heap;
+ }
+ codeSize = p->text->length + RUNTIME * THUNKSIZE + STUBSIZE;
+ dataStart = (codeSize + page - 1) / page * page;
+ size = dataStart + p->data->length;
+ if (!(base = low(size))) {
+   EM_error(0, "cannot map memory below 4GB to run in");
+   return -1;
+ }
+ memcpy(base, p->text->text, p->text->length);
+ memcpy(base + dataStart, p->data->text, p->data->length);
+ for (i = 0, q = base + p->text->length; i < RUNTIME; i++) {
+   *q++ = 0x48; *q++ = (char)0xB8; q = put64(q, runtime[i].f);
+   *q++ = 0x49; *q++ = (char)0xBB; q = put64(q, (void *)jitCall);
+   *q++ = 0x41; *q++ = (char)0xFF; *q++ = (char)0xE3;
+ }
+ *q++ = 0x48; *q++ = (char)0xB9; q = put64(q, (void *)jitReturn);
+ *q++ = (char)0xFF; *q++ = (char)0xE1;
+
+ for (i = 0; i < p->relocs->length / sizeof(struct reloc); i++) {
+   struct reloc *r = (struct reloc *)p->relocs->text + i;
+   char *s = r->sym ? address(p, base, dataStart, r->sym) : base + r->self;
+   int v;
+   if (!s) {
+     EM_error(0, "undefined symbol %s", S_name(r->sym));
+     munmap(base, size);
+     return -1;
+   }
+   memcpy(&v, base + r->offset, 4);
+   v += r->pcRelative ? (int)(s - (base + r->offset)) : (int)(unsigned long)s;
+   memcpy(base + r->offset, &v, 4);
+ }
+ entry = address(p, base, dataStart, Temp_namedlabel("tigermain"));
+ if (!entry || entry >= base + dataStart) {
+   EM_error(0, "no tigermain to run");
+   munmap(base, size);
+   return -1;
+ }
+ mprotect(base, dataStart, PROT_READ | PROT_EXEC);
+
+ bump[0] = (unsigned)(unsigned long)(heap + 8);
+ bump[1] = (unsigned)(unsigned long)(heap + HEAPSIZE);
+ consts = alloc(256 * sizeof(struct string));
+ for (i = 0; i < 256; i++) {
+   consts[i].length = 1;
+   consts[i].chars[0] = i;
+ }
+ empty = alloc(sizeof(struct string));
+ empty->length = 0;
+
+ if (!(status = setjmp(escape)))
+   jitEnter(entry, stack + STACKSIZE, base + codeSize - STUBSIZE);
+ fflush(stdout);
+ madvise(heap, (char *)(unsigned long)bump[0] - heap, MADV_DONTNEED);
+ munmap(base, size);
+ return status;
+}
+
+#else
+
+int JIT_run(JIT_program p)
+{
+ EM_error(0, "--run needs an x86-64 host");
+ return -1;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef JIT_H
+#define JIT_H
+/*
+ * jit.h - Running compiled programs in the compiler's process, for --run.
+ *
+ * A program is built up like an object (see object.h), from functions
+ * encoded for EN_LOW64 and from read-only data.  JIT_run lays them out
+ * in executable memory below 4GB, binds the calls into the runtime to
+ * this module's own copy of runtime.c, and calls tigermain on a stack
+ * and a heap that are also below 4GB, so that Tiger's pointers still fit
+ * in a word.
+ */
+
+typedef struct JIT_program_ *JIT_program;
+
+/* An empty program, kept (with its memory) for the life of the compiler */
+JIT_program JIT_Program(void);
+
+/* Empty "p" for the next file */
+void JIT_reset(JIT_program p);
+
+/* As OBJ_function and OBJ_data */
+void JIT_function(JIT_program p, Temp_label name, char *code, size_t length,
+                  EN_reloc *relocs, int nrelocs);
+void JIT_data(JIT_program p, Temp_label name, char *bytes, size_t length);
+
+/* Run "p" from tigermain, reading stdin and writing stdout.  Its exit
+ * status: 0, or what the runtime exits with; -1, with an error
+ * reported, if it cannot be run. */
+int JIT_run(JIT_program p);
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "util.h"
 #include "symbol.h"
 #include "temp.h"
@@ -10,17 +11,7 @@
 #include "flowgraph.h"
 #include "liveness.h"
 #include "table.h"
-
-static void enterLiveMap(G_table t, G_node flowNode, My_Temp_TempList temps) {
-	G_enter(t, flowNode, temps);
-}
-
-static My_Temp_TempList lookupLiveMap(G_table t, G_node flowNode) {
-	My_Temp_TempList q = G_look(t, flowNode);
-	if( q == NULL ) {
-		return My_Empty_Temp_TempList();
-	}
-}
+#include "bitset.h"
 
 Live_moveList Live_MoveList(G_node src, G_node dst, Live_moveList tail) {
 	Live_moveList lm = (Live_moveList) checked_malloc(sizeof(*lm));
@@ -35,107 +26,301 @@ Temp_temp Live_gtemp(G_node n) {
 }
 
 
-static TAB_table temp2GnodeTable;
-// Find G_node in TAB_table using Temp_temp
-// If Temp_temp t is not found in table, create a new g_node in graph,
-// and add it into table.
-static G_node lookupTemp2GnodeTAB(G_graph graph, Temp_temp t) {
-	G_node node = TAB_look(temp2GnodeTable, t);
-	if(node == NULL) {
-		node = G_Node(graph, t);
-		TAB_enter(temp2GnodeTable, t, node);
+// The dataflow runs on dense indices: temps are numbered 0..ntemps-1 in the
+// order liveness first meets them, and flow nodes by G_nodeKey.
+static __thread TAB_table temp2index;
+static __thread Temp_temp *index2temp;
+static __thread G_node *index2gnode;
+static __thread int ntemps, maxtemps;
+
+static int tempIndex(Temp_temp t) {
+	int i = (int)(long)TAB_look(temp2index, t);   // index + 1, 0 if unseen
+	if(i == 0) {
+		if(ntemps == maxtemps) {
+			Temp_temp *old = index2temp;
+			maxtemps *= 2;
+			index2temp = checked_malloc(maxtemps * sizeof(Temp_temp));
+			memcpy(index2temp, old, ntemps * sizeof(Temp_temp));
+		}
+		index2temp[ntemps] = t;
+		i = ++ntemps;
+		TAB_enter(temp2index, t, (void *)(long)i);
 	}
-	return node;
+	return i - 1;
 }
 
-void addEdge(G_graph g, Temp_temp u, Temp_temp v) {
+// def/use of one flow node, as temp indices
+struct liveInfo {
+	int *def, ndef;
+	int *use, nuse;
+};
+
+static int *tempIndices(Temp_tempList list, int *n) {
+	Temp_tempList l;
+	int *p, i = 0;
+	for(*n = 0, l = list; l; l = l->tail)
+		++*n;
+	p = checked_malloc(*n * sizeof(int));
+	for(l = list; l; l = l->tail)
+		p[i++] = tempIndex(l->head);
+	return p;
+}
+
+// Find the interference-graph node of temp index i, creating it on first use.
+static G_node indexGnode(G_graph graph, int i) {
+	if(index2gnode[i] == NULL)
+		index2gnode[i] = G_Node(graph, index2temp[i]);
+	return index2gnode[i];
+}
+
+static void addEdge(G_graph g, int u, int v) {
 	if(u == v)
 		return;
-    // printf("-------------------------------------link %d-%d\n", getTempNum(u), getTempNum(v));
-	G_addEdge(lookupTemp2GnodeTAB(g, u), lookupTemp2GnodeTAB(g, v));
-    G_addEdge(lookupTemp2GnodeTAB(g, v), lookupTemp2GnodeTAB(g, u));
+	G_addEdge(indexGnode(g, u), indexGnode(g, v));
+	G_addEdge(indexGnode(g, v), indexGnode(g, u));
 }
 
-struct Live_graph Live_liveness(G_graph flow) {
-	G_table liveInMap = G_empty();
-	G_table liveOutMap = G_empty();
-    temp2GnodeTable = TAB_empty();
-	// nodes tobe update, like a queue.
-	My_G_nodeList edgeNodes =  cloneFromGnodeList(G_nodes(flow));
-	
-    G_nodeList tNodeList = G_nodes(flow);
-    for(; tNodeList; tNodeList = tNodeList->tail) {
-        My_G_nodeList t = cloneFromGnodeList(G_succ(tNodeList->head));
-        if(emptyMyGnodeList(t) == TRUE) {
-            printf("--------------------------------------------------12312312312--------------\n");
-            enterLiveMap(liveOutMap, tNodeList->head, cloneFromTempList(F_calleeSaves()));
-        } 
-    }
+// Reverse postorder of the reversed CFG: depth-first along predecessor
+// edges from the exit blocks, so a block is ordered before the blocks
+// that flow into it.  Blocks that never reach an exit (infinite loops)
+// are searched from afterwards.
+static int *reversePostorder(G_graph blocks, int nb) {
+	int *order = checked_malloc(nb * sizeof(int)), pos = nb, sp, i;
+	G_node *stack = checked_malloc(nb * sizeof(G_node));
+	G_nodeList *next = checked_malloc(nb * sizeof(G_nodeList));
+	bool *seen = checked_malloc(nb * sizeof(bool));
+	G_node *all = checked_malloc(nb * sizeof(G_node));
+	G_nodeList l;
+	int pass;
 
-	
-	struct Live_graph lg = {G_Graph(), NULL};
-	Temp_tempList tmp;
-
-	// Construct live in & live out Map based on control flow graph
-	// While the set is not empty, keep updating
-	while(emptyMyGnodeList(edgeNodes) == FALSE) {
-		// Get node from queue, get instr's <liveIn>, <liveOut>
-		G_node curNode = popMyGnodeList(edgeNodes);
-		My_Temp_TempList curNodeLiveOut = lookupLiveMap(liveOutMap, curNode);
-		My_Temp_TempList curNodeLiveIn = lookupLiveMap(liveInMap, curNode);
-
-		My_Temp_TempList use = cloneFromTempList(FG_use(curNode));
-		My_Temp_TempList def = cloneFromTempList(FG_def(curNode));
-		My_Temp_TempList liveIn = cloneMyTempList(curNodeLiveOut);
-
-		// remove <use> from <liveIn> temperaily, so the <def> will not interfere with <use>
-		if(FG_isMove(curNode) == TRUE) {
-			liveIn = subMyTempList(liveIn, use);
-            // assert(FG_def(curNode)->tail == NULL && FG_use(curNode)->tail == NULL);
-			lg.moves = Live_MoveList(lookupTemp2GnodeTAB(lg.graph, FG_def(curNode)->head),
-									 lookupTemp2GnodeTAB(lg.graph, FG_use(curNode)->head), lg.moves);
+	memset(seen, 0, nb * sizeof(bool));
+	for(l = G_nodes(blocks); l; l = l->tail)
+		all[G_nodeKey(l->head)] = l->head;
+
+	for(pass = 0; pass < 2; ++pass)
+		for(i = 0; i < nb; ++i) {
+			if(seen[i] || (pass == 0 && G_succ(all[i]) != NULL))
+				continue;
+			seen[i] = TRUE;
+			stack[0] = all[i];
+			next[0] = G_pred(all[i]);
+			sp = 1;
+			while(sp > 0) {
+				if(next[sp-1] == NULL) {
+					order[--pos] = G_nodeKey(stack[--sp]);
+					continue;
+				}
+				l = next[sp-1];
+				next[sp-1] = l->tail;
+				if(!seen[G_nodeKey(l->head)]) {
+					seen[G_nodeKey(l->head)] = TRUE;
+					stack[sp] = l->head;
+					next[sp] = G_pred(l->head);
+					sp++;
+				}
+			}
+		}
+	assert(pos == 0);
+	return order;
+}
+
+// The solved dataflow of the flow graph being analysed: def/use of every
+// instruction, and live-out of every basic block.
+static __thread int ninstrs, nblocks;
+static __thread G_node *blocks;
+static __thread struct liveInfo *info;
+static __thread Bit_set *liveOut;
+static __thread int *regs, nregs;
+
+static void solve(G_graph flow) {
+	int i, j, k, b;
+	G_graph blockGraph = FG_BlockGraph(flow);
+	Bit_set *gen, *kill, live;
+	int *calleeSaves, ncalleeSaves;
+	G_nodeList l;
+
+	ninstrs = G_nodesNumber(flow);
+	nblocks = G_nodesNumber(blockGraph);
+	blocks = checked_malloc(nblocks * sizeof(G_node));
+	info = checked_malloc(ninstrs * sizeof(struct liveInfo));
+	gen = checked_malloc(nblocks * sizeof(Bit_set));
+	kill = checked_malloc(nblocks * sizeof(Bit_set));
+	liveOut = checked_malloc(nblocks * sizeof(Bit_set));
+
+	temp2index = TAB_empty();
+	ntemps = 0;
+	maxtemps = 64;
+	index2temp = checked_malloc(maxtemps * sizeof(Temp_temp));
+
+	for(l = G_nodes(flow); l; l = l->tail) {
+		i = G_nodeKey(l->head);
+		info[i].def = tempIndices(FG_def(l->head), &info[i].ndef);
+		info[i].use = tempIndices(FG_use(l->head), &info[i].nuse);
+	}
+	calleeSaves = tempIndices(F_calleeSaves(), &ncalleeSaves);
+	regs = tempIndices(F_registers(), &nregs);
+	live = Bit_Set(ntemps);
+
+	// Summarize each block once: gen holds the temps it uses before
+	// defining them, kill the temps it defines.  Callee-save registers
+	// are live out of the exit blocks.
+	for(l = G_nodes(blockGraph); l; l = l->tail) {
+		FG_block block = G_nodeInfo(l->head);
+		b = G_nodeKey(l->head);
+		blocks[b] = l->head;
+		gen[b] = Bit_Set(ntemps);
+		kill[b] = Bit_Set(ntemps);
+		liveOut[b] = Bit_Set(ntemps);
+		for(j = block->length - 1; j >= 0; --j) {
+			struct liveInfo *in = &info[G_nodeKey(block->instrs[j])];
+			for(k = 0; k < in->ndef; ++k) {
+				Bit_remove(gen[b], in->def[k]);
+				Bit_add(kill[b], in->def[k]);
+			}
+			for(k = 0; k < in->nuse; ++k)
+				Bit_add(gen[b], in->use[k]);
+		}
+		if(G_succ(l->head) == NULL)
+			for(k = 0; k < ncalleeSaves; ++k)
+				Bit_add(liveOut[b], calleeSaves[k]);
+	}
+
+	// Iterate live-out to a fixpoint.  Pending blocks are visited in
+	// reverse postorder of the reversed CFG, so one sweep carries liveness
+	// all the way up an acyclic region and loops need only a few more.
+	// live-in = gen + (live-out - kill) is only needed transiently to
+	// update the predecessors, so it is never stored.
+	{
+		int *order = reversePostorder(blockGraph, nblocks), *rank;
+		Bit_set pending = Bit_Set(nblocks);
+		rank = checked_malloc(nblocks * sizeof(int));
+		for(i = 0; i < nblocks; ++i) {
+			rank[order[i]] = i;
+			Bit_add(pending, i);
 		}
-		liveIn = unionMyTempList(liveIn, def);
-		
-		// construct interference graph
-		Temp_tempList d = def->head;
-		Temp_tempList l = liveIn->head;
-		for(; d; d = d->tail) {
-			for(l = liveIn->head; l; l = l->tail) {
-				addEdge(lg.graph, d->head, l->head);
-					// lg.interfereTemps = Live_InterfereTempList(
-					// 		lookupTemp2GnodeTAB(lg.graph, l->head), 
-					// 		lookupTemp2GnodeTAB(lg.graph, d->head), lg.interfereTemps);
+		// sweep the pending blocks in rank order, wrapping round to pick up
+		// predecessors ranked at or before the current block
+		i = 0;
+		while((i = Bit_next(pending, i)) >= 0 || (i = Bit_next(pending, 0)) >= 0) {
+			Bit_remove(pending, i);
+			b = order[i];
+			Bit_copy(live, liveOut[b]);
+			Bit_diff(live, kill[b]);
+			Bit_union(live, gen[b]);
+			for(l = G_pred(blocks[b]); l; l = l->tail) {
+				j = G_nodeKey(l->head);
+				if(Bit_union(liveOut[j], live))
+					Bit_add(pending, rank[j]);
 			}
 		}
-				
-		// calculate live in map based on live out map
-		liveIn = unionMyTempList(use, subMyTempList(liveIn, def));
-		// if live in map isn't equal to origin one, then update all pre nodes, 
-		// ans add these pre nodes into updated node list
-		if(isEqualMyTempList(liveIn, curNodeLiveIn) == FALSE) {
-			enterLiveMap(liveInMap, curNode, liveIn);
-			G_nodeList preNodes = G_pred(curNode);
-			for(; preNodes != NULL; preNodes = preNodes->tail) {
-				My_Temp_TempList preNodeLiveOut = lookupLiveMap(liveOutMap, preNodes->head);
-				preNodeLiveOut = unionMyTempList(liveIn, preNodeLiveOut);
-				enterLiveMap(liveOutMap, preNodes->head, preNodeLiveOut);
-                checkedAppendMyGnodeList(edgeNodes, preNodes->head);
+	}
+}
+
+// step "live" from the live-out of an instruction to its live-in
+static void liveIn(Bit_set live, struct liveInfo *in) {
+	int k;
+	for(k = 0; k < in->ndef; ++k)
+		Bit_remove(live, in->def[k]);
+	for(k = 0; k < in->nuse; ++k)
+		Bit_add(live, in->use[k]);
+}
+
+struct Live_graph Live_liveness(G_graph flow) {
+	int i, j, k, b;
+	Bit_set live;
+	struct Live_graph lg = {G_Graph(), NULL};
+
+	solve(flow);
+	index2gnode = checked_malloc(ntemps * sizeof(G_node));
+	memset(index2gnode, 0, ntemps * sizeof(G_node));
+	live = Bit_Set(ntemps);
+
+	// construct interference graph, sweeping each block backwards from its
+	// live-out: every def interferes with whatever else is live out of its
+	// instruction, except the source of a move.
+	for(b = 0; b < nblocks; ++b) {
+		FG_block block = G_nodeInfo(blocks[b]);
+		Bit_copy(live, liveOut[b]);
+		for(j = block->length - 1; j >= 0; --j) {
+			G_node node = block->instrs[j];
+			struct liveInfo *in = &info[G_nodeKey(node)];
+			if(FG_isMove(node) == TRUE) {
+				for(k = 0; k < in->nuse; ++k)
+					Bit_remove(live, in->use[k]);
+				lg.moves = Live_MoveList(indexGnode(lg.graph, in->def[0]),
+										 indexGnode(lg.graph, in->use[0]), lg.moves);
 			}
+			for(k = 0; k < in->ndef; ++k)
+				Bit_add(live, in->def[k]);
+			for(k = 0; k < in->ndef; ++k)
+				for(i = Bit_next(live, 0); i >= 0; i = Bit_next(live, i + 1))
+					addEdge(lg.graph, in->def[k], i);
+			// step to the live-out of the instruction above
+			liveIn(live, in);
 		}
 	}
 
-    Temp_tempList regs = F_registers();
-    Temp_tempList regs2 = F_registers();
-    for(; regs; regs = regs->tail) {
-        for(; regs2; regs2 = regs2->tail) {
-            addEdge(lg.graph, regs->head, regs2->head);
-        }
-    }
+	// machine registers all interfere with each other
+	for(i = 0; i < nregs; ++i)
+		for(j = 0; j < nregs; ++j)
+			addEdge(lg.graph, regs[i], regs[j]);
 
 	return lg;
 }
 
+static void coverInterval(Live_interval iv, int pos) {
+	if(pos < iv->start)
+		iv->start = pos;
+	if(pos > iv->end)
+		iv->end = pos;
+	if(iv->cover)
+		Bit_add(iv->cover, pos);
+}
+
+Live_interval *Live_intervals(G_graph flow, Temp_tempList exact, int *count) {
+	int i, j, k, b;
+	Bit_set live;
+	Live_interval *iv;
+
+	solve(flow);
+	live = Bit_Set(ntemps);
+	iv = checked_malloc(ntemps * sizeof(Live_interval));
+	for(i = 0; i < ntemps; ++i) {
+		iv[i] = checked_malloc(sizeof(struct Live_interval_));
+		iv[i]->temp = index2temp[i];
+		iv[i]->start = 2 * ninstrs;
+		iv[i]->end = -1;
+		iv[i]->cover = NULL;
+	}
+	for(; exact; exact = exact->tail) {
+		i = (int)(long)TAB_look(temp2index, exact->head);   // index + 1
+		if(i > 0)
+			iv[i - 1]->cover = Bit_Set(2 * ninstrs);
+	}
+
+	// Instruction "key" reads its uses at 2*key and writes its defs at
+	// 2*key+1.  A temp live out of it is live at 2*key+1, and at 2*key as
+	// well unless the instruction defines it.
+	for(b = 0; b < nblocks; ++b) {
+		FG_block block = G_nodeInfo(blocks[b]);
+		Bit_copy(live, liveOut[b]);
+		for(j = block->length - 1; j >= 0; --j) {
+			int pos = 2 * G_nodeKey(block->instrs[j]);
+			struct liveInfo *in = &info[pos / 2];
+			for(k = 0; k < in->ndef; ++k)
+				Bit_add(live, in->def[k]);
+			for(i = Bit_next(live, 0); i >= 0; i = Bit_next(live, i + 1))
+				coverInterval(iv[i], pos + 1);
+			liveIn(live, in);
+			for(i = Bit_next(live, 0); i >= 0; i = Bit_next(live, i + 1))
+				coverInterval(iv[i], pos);
+		}
+	}
+
+	*count = ntemps;
+	return iv;
+}
+
 
 
 /* My_Live_MoveList functions */
@@ -52,4 +52,19 @@ Temp_temp Live_gtemp(G_node n);
 
 struct Live_graph Live_liveness(G_graph flow);
 
+/* Live range of a temp.  Instruction i (its flow-node key) reads at
+ * position 2i and writes at 2i+1; the range runs from the first to the
+ * last position where the temp is live, read or written.  For temps
+ * listed in "exact", which come and go a lot (machine registers),
+ * "cover" also marks exactly those positions; it is NULL for the rest. */
+typedef struct Live_interval_ *Live_interval;
+struct Live_interval_ {
+	Temp_temp temp;
+	int start, end;
+	Bit_set cover;
+};
+
+/* Live ranges of all the temps in "flow"; "*count" is set to how many */
+Live_interval *Live_intervals(G_graph flow, Temp_tempList exact, int *count);
+
 #endif
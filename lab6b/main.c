@@ -3,6 +3,11 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include "util.h"
 #include "symbol.h"
 #include "types.h"
@@ -22,26 +27,98 @@
 #include "parse.h"
 #include "codegen.h"
 #include "regalloc.h"
+#include "timevar.h"
+#include "trace.h"
+#include "server.h"
+#include "cache.h"
+#include "encode.h"
+#include "object.h"
+#include "jit.h"
+#include "interp.h"
 
 extern bool anyErrors;
 
-/* print the assembly language instructions to filename.s */
-static void doProc(FILE *out, F_frame frame, T_stm body)
+/* register allocator, chosen by -fregalloc= */
+static struct RA_result (*regAlloc)(F_frame f, AS_instrList il) = RA_regAlloc;
+
+/* -fobject: machine code and an ELF object, not assembly; --run: machine
+ * code for this machine, run in process; --interpret: no code, the IR
+ * trees run in process */
+static bool objectOutput, runOutput, interpretOutput;
+
+/* sizes of what the phases produce, for the time report */
+static int stmCount(T_stmList l)
+{
+    int n = 0;
+    for (; l; l = l->tail)
+        n++;
+    return n;
+}
+
+static int instrCount(AS_instrList l)
+{
+    int n = 0;
+    for (; l; l = l->tail)
+        n++;
+    return n;
+}
+
+/* the body of "frame"'s procedure as canonical trees, in trace order */
+static T_stmList canonicalize(F_frame frame, T_stm body)
+{
+	T_stmList stmList;
+	struct C_block blocks;
+	C_stmListList bl;
+	int n;
+
+    body = F_procEntryExit1(frame, body);
+    TV_start(TV_LINEARIZE);
+	stmList = C_linearize(body);
+    TV_stop(TV_LINEARIZE, stmCount(stmList));
+    TV_start(TV_BASIC_BLOCKS);
+    blocks = C_basicBlocks(stmList);
+    for (n = 0, bl = blocks.stmLists; bl; bl = bl->tail)
+        n++;
+    TV_stop(TV_BASIC_BLOCKS, n);
+    TV_start(TV_TRACE);
+    stmList = C_traceSchedule(blocks);
+    TV_stop(TV_TRACE, stmCount(stmList));
+    return stmList;
+}
+
+/* print the assembly language instructions to filename.s, or with
+ * -fobject or --run append their code to "out" and its relocations to
+ * "relocs" */
+static void doProc(AS_buffer out, AS_buffer relocs, F_frame frame, T_stm body, int order)
 {
 	// printIRTree(body);
 	AS_proc proc;
 	T_stmList stmList;
 	AS_instrList iList;
+	CA_key key = NULL;
+	size_t start = out->length;
 
 	F_tempMap = Temp_empty();
+    Temp_function(S_name(F_name(frame)));
+    TV_unit(S_name(F_name(frame)), order);
+    TR_function(S_name(F_name(frame)));
 
-    body = F_procEntryExit1(frame, body);
-	stmList = C_linearize(body);
-    stmList = C_traceSchedule(C_basicBlocks(stmList));
+    stmList = canonicalize(frame, body);
+    if (CA_enabled() && !objectOutput && !runOutput) {
+        bool hit;
+        TV_start(TV_CACHE);
+        key = CA_procKey(frame, stmList);
+        hit = CA_fetch(key, out);
+        TV_stop(TV_CACHE, hit);
+        if (hit)
+            return;
+    }
   
     // fprintf(out, "---------------------%s----------------------\n", F_name(frame));    
   	// printStmList(out, stmList);
+    TV_start(TV_CODEGEN);
 	iList  = F_codegen(frame, stmList); /* 9 */
+    TV_stop(TV_CODEGEN, instrCount(iList));
 
     // fprintf(out, "------------------------------\n");
     // Temp_dumpMap(out, F_preColored());
@@ -53,61 +130,479 @@ static void doProc(FILE *out, F_frame frame, T_stm body)
 
 
     iList = F_procEntryExit2(iList);
-	struct RA_result ra = RA_regAlloc(frame, iList);  /* 10, 11 */
+	struct RA_result ra = regAlloc(frame, iList);  /* 10, 11 */
     assert(ra.coloring);
 
     // fprintf(out, "------------------------------\n");
     // AS_printInstrList(out, iList, Temp_layerMap(F_tempMap, Temp_name()));
     // fprintf(out, "--------------------------------!@#!@#!@#\n");
 
+    TV_start(TV_EMIT);
     proc = F_procEntryExit3(frame, iList);
-    fprintf(out, "%s\n", proc->prolog);
-	AS_printInstrList (out, proc->body,
+    if (objectOutput || runOutput) {
+        EN_encode(out, relocs, proc->body,
+                  Temp_layerMap(Temp_layerMap(ra.coloring, F_tempMap), Temp_name()),
+                  runOutput ? EN_LOW64 : EN_I386);
+        TV_stop(TV_EMIT, instrCount(proc->body));
+        return;
+    }
+    AS_puts(out, proc->prolog);
+    AS_puts(out, "\n");
+	AS_emitInstrList (out, proc->body,
 					   Temp_layerMap(Temp_layerMap(ra.coloring, F_tempMap), Temp_name()));
-	fprintf(out, "%s\n\n", proc->epilog);
+    AS_puts(out, proc->epilog);
+    AS_puts(out, "\n\n");
+    if (key)
+        CA_store(key, out->text + start, out->length - start);
+    TV_stop(TV_EMIT, instrCount(proc->body));
 }
 
-int main(int argc, string *argv)
+/* The back end of every proc fragment is a job.  Jobs share nothing but
+ * the front end's results, so a pool of threads takes them in turn; each
+ * job's assembly is kept in its thread's output buffer and written out in
+ * fragment order, so the .s file does not depend on the number of
+ * threads.  The pool and the buffers live as long as the compiler,
+ * serving every file of a batch. */
+struct job {
+    F_frame frame;
+    T_stm body;
+    AS_piece text, relocs;      /* relocs: with -fobject, of EN_reloc */
+};
+
+static struct job *jobs;
+static int njobs, nextJob;
+static int jobOrder;            /* time report order of jobs[0] */
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static int workers, generation, busy;
+
+static AS_buffer mainBuffer;    /* the main thread's, also for strings */
+static AS_buffer mainRelocs;
+
+/* the last file's text has been written, so "out" starts empty */
+static void runJobs(U_region backend, AS_buffer out, AS_buffer relocs)
+{
+    U_region prev = U_regionSwitch(backend);
+    int i;
+    AS_bufferReset(out);
+    AS_bufferReset(relocs);
+    while ((i = __atomic_fetch_add(&nextJob, 1, __ATOMIC_RELAXED)) < njobs) {
+        jobs[i].text.buffer = out;
+        jobs[i].text.offset = out->length;
+        jobs[i].relocs.buffer = relocs;
+        jobs[i].relocs.offset = relocs->length;
+        doProc(out, relocs, jobs[i].frame, jobs[i].body, jobOrder + i);
+        jobs[i].text.length = out->length - jobs[i].text.offset;
+        jobs[i].relocs.length = relocs->length - jobs[i].relocs.offset;
+        U_regionReset(backend);
+    }
+    Temp_function(NULL);
+    F_tempMap = NULL;
+    U_regionSwitch(prev);
+}
+
+static void *worker(void *unused)
 {
+    U_region backend = U_Region("backend");
+    AS_buffer out = AS_Buffer(), relocs = AS_Buffer();
+    int seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&poolLock);
+        while (generation == seen)
+            pthread_cond_wait(&workReady, &poolLock);
+        seen = generation;
+        pthread_mutex_unlock(&poolLock);
+
+        runJobs(backend, out, relocs);
+
+        pthread_mutex_lock(&poolLock);
+        if (--busy == 0)
+            pthread_cond_signal(&workDone);
+        pthread_mutex_unlock(&poolLock);
+    }
+    return NULL;
+}
+
+/* start the threads that help this one run jobs */
+static void startPool(int threads)
+{
+    pthread_t t;
+    mainBuffer = AS_Buffer();
+    mainRelocs = AS_Buffer();
+    for (workers = 0; workers < threads - 1; workers++)
+        if (pthread_create(&t, NULL, worker, NULL) != 0)
+            break;
+}
+
+/* run every job, on this thread and the pool's */
+static void runPool(void)
+{
+    static U_region backend = NULL;
+    if (!backend)
+        backend = U_Region("backend");
+    pthread_mutex_lock(&poolLock);
+    nextJob = 0;
+    busy = workers;
+    generation++;
+    pthread_cond_broadcast(&workReady);
+    pthread_mutex_unlock(&poolLock);
+
+    runJobs(backend, mainBuffer, mainRelocs);
+
+    pthread_mutex_lock(&poolLock);
+    while (busy > 0)
+        pthread_cond_wait(&workDone, &poolLock);
+    pthread_mutex_unlock(&poolLock);
+}
+
+static int units;               /* time report units so far */
+static bool mapOutput;          /* -femit=mmap */
+
+/* Write the code of the fragments to "fd" as an ELF object */
+static bool writeObject(F_fragList frags, int fd)
+{
+    static OBJ_object object = NULL;
+    F_fragList f;
+    int i;
+
+    if (!object)
+        object = OBJ_Object();
+    OBJ_reset(object);
+    for (f = frags, i = 0; f; f = f->tail) {
+        if (f->head->kind == F_procFrag) {
+            struct job *j = &jobs[i++];
+            OBJ_function(object, F_name(j->frame),
+                         j->text.buffer->text + j->text.offset, j->text.length,
+                         (EN_reloc *)(j->relocs.buffer->text + j->relocs.offset),
+                         j->relocs.length / sizeof(EN_reloc));
+        } else if (f->head->kind == F_stringFrag) {
+            size_t start = mainBuffer->length;
+            F_stringData(mainBuffer, f->head);
+            OBJ_data(object, f->head->u.stringg.label,
+                     mainBuffer->text + start, mainBuffer->length - start);
+        }
+    }
+    return OBJ_write(object, fd);
+}
+
+/* Run the fragments' code; FALSE if it cannot run or exits nonzero */
+static bool runProgram(F_fragList frags)
+{
+    static JIT_program program = NULL;
+    F_fragList f;
+    int i;
+
+    if (!program)
+        program = JIT_Program();
+    JIT_reset(program);
+    for (f = frags, i = 0; f; f = f->tail) {
+        if (f->head->kind == F_procFrag) {
+            struct job *j = &jobs[i++];
+            JIT_function(program, F_name(j->frame),
+                         j->text.buffer->text + j->text.offset, j->text.length,
+                         (EN_reloc *)(j->relocs.buffer->text + j->relocs.offset),
+                         j->relocs.length / sizeof(EN_reloc));
+        } else if (f->head->kind == F_stringFrag) {
+            size_t start = mainBuffer->length;
+            F_stringData(mainBuffer, f->head);
+            JIT_data(program, f->head->u.stringg.label,
+                     mainBuffer->text + start, mainBuffer->length - start);
+        }
+    }
+    return JIT_run(program) == 0;
+}
+
+/* Run the fragments' canonical trees, made here on the main thread; FALSE
+ * if they cannot run or exit nonzero */
+static bool interpretProgram(F_fragList frags)
+{
+    static IN_program program = NULL;
+    F_fragList f;
+
+    if (!program)
+        program = IN_Program();
+    IN_reset(program);
+    AS_bufferReset(mainBuffer);
+    for (f = frags; f; f = f->tail) {
+        if (f->head->kind == F_procFrag) {
+            F_frame frame = f->head->u.proc.frame;
+            Temp_function(S_name(F_name(frame)));
+            TV_unit(S_name(F_name(frame)), units++);
+            IN_function(program, frame, canonicalize(frame, f->head->u.proc.body));
+        } else if (f->head->kind == F_stringFrag) {
+            size_t start = mainBuffer->length;
+            F_stringData(mainBuffer, f->head);
+            IN_data(program, f->head->u.stringg.label,
+                    mainBuffer->text + start, mainBuffer->length - start);
+        }
+    }
+    Temp_function(NULL);
+    return IN_run(program) == 0;
+}
+
+/* Compile "file" to file.s (file.o with -fobject), or if "in" is not
+ * NULL, the source read from it (and closed) to "out"; FALSE if it has
+ * errors. */
+static bool compile(string file, FILE *in, FILE *out)
+{
+    // front end data (absyn, IR trees, fragments) lives until the file is
+    // written; each procedure's back end work is dropped once it is emitted.
+    static U_region frontend = NULL;
+    U_region prev;
     A_exp absyn_root;
-    S_table base_env, base_tenv;
-    F_fragList frags;
-    char outfile[100];
-    FILE *out = stdout;
-
-    if (argc == 2) {
-        absyn_root = parse(argv[1]);
-        if (!absyn_root)
-	       return 1;
-	 
-        #if 0
-           pr_exp(out, absyn_root, 0); /* print absyn data structure */
-           fprintf(out, "\n");
-        #endif
-    	//If you have implemented escape analysis, uncomment this
-        Esc_findEscape(absyn_root); /* set varDec's escape field */
-           // printf("-----------ok---------\n");
-        frags = SEM_transProg(absyn_root);
-        if (anyErrors) return 1; /* don't continue */
+    F_fragList frags, f;
+    char outfile[1024];
+    AS_piece *pieces;
+    int i, n, fd;
+
+    if (!frontend)
+        frontend = U_Region("frontend");
+    prev = U_regionSwitch(frontend);
+    TV_unit(file, units++);
 
+    TV_start(TV_PARSE);
+    absyn_root = in ? parseStream(file, in) : parse(file);
+    TV_stop(TV_PARSE, 0);
+    if (!absyn_root) {
+        U_regionSwitch(prev);
+        U_regionReset(frontend);
+        return FALSE;
+    }
+
+    #if 0
+       pr_exp(out, absyn_root, 0); /* print absyn data structure */
+       fprintf(out, "\n");
+    #endif
+	//If you have implemented escape analysis, uncomment this
+    TV_start(TV_ESCAPE);
+    Esc_findEscape(absyn_root); /* set varDec's escape field */
+    TV_stop(TV_ESCAPE, 0);
+       // printf("-----------ok---------\n");
+    TV_start(TV_SEMANT);
+    frags = SEM_transProg(absyn_root);
+    njobs = 0;
+    for (f = frags, n = 0; f; f = f->tail, n++)
+        if (f->head->kind == F_procFrag)
+            njobs++;
+    TV_stop(TV_SEMANT, n);
+    if (anyErrors) { /* don't continue */
+        U_regionSwitch(prev);
+        U_regionReset(frontend);
+        return FALSE;
+    }
+
+    if (interpretOutput && !in) {
+        bool ran = interpretProgram(frags);
+        U_regionSwitch(prev);
+        U_regionReset(frontend);
+        return ran;
+    }
+
+    /* Chapter 8, 9, 10, 11 & 12 */
+    jobs = checked_malloc(njobs * sizeof(struct job));
+    for (f = frags, i = 0; f; f = f->tail)
+        if (f->head->kind == F_procFrag) {
+            jobs[i].frame = f->head->u.proc.frame;
+            jobs[i].body = f->head->u.proc.body;
+            i++;
+        }
+    jobOrder = units;
+    units += njobs;
+    runPool();
+
+    if (runOutput && !in) {
+        bool ran = !anyErrors && runProgram(frags);
+        U_regionSwitch(prev);
+        U_regionReset(frontend);
+        return ran;
+    }
+    if (objectOutput && !in) {
+        snprintf(outfile, sizeof(outfile), "%s.o", file);
+        fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0 || !writeObject(frags, fd))
+            EM_error(0, "cannot write %s", outfile);
+        if (fd >= 0)
+            close(fd);
+        U_regionSwitch(prev);
+        U_regionReset(frontend);
+        return !anyErrors;
+    }
+
+    /* the text of every fragment, in order */
+    pieces = checked_malloc(n * sizeof(AS_piece));
+    for (f = frags, n = 0, i = 0; f; f = f->tail, n++) {
+        if (f->head->kind == F_procFrag)
+            pieces[n] = jobs[i++].text;
+        else if (f->head->kind == F_stringFrag) {
+            //TODO  \n, \t these should be treated as \\n , \\t
+            //TODO move the .string format into frame.h  x86frame.c
+            pieces[n].buffer = mainBuffer;
+            pieces[n].offset = mainBuffer->length;
+            F_string(mainBuffer, f->head);
+            pieces[n].length = mainBuffer->length - pieces[n].offset;
+        }
+    }
+
+    if (in) {
+        for (i = 0; i < n; i++)
+            fwrite(pieces[i].buffer->text + pieces[i].offset, 1, pieces[i].length, out);
+    } else {
         /* convert the filename */
-        sprintf(outfile, "%s.s", argv[1]);
-        out = fopen(outfile, "w");
-        /* Chapter 8, 9, 10, 11 & 12 */
-        for (;frags;frags=frags->tail) {
-            if (frags->head->kind == F_procFrag) 
-                doProc(out, frags->head->u.proc.frame, frags->head->u.proc.body);
-            else if (frags->head->kind == F_stringFrag) {
-                //TODO  \n, \t these should be treated as \\n , \\t
-                //TODO move the .string format into frame.h  x86frame.c
-                // fprintf(out, "%s\n", F_string(frags->head));
-                F_string(out, frags->head);
-                // fprintf(out, "%s: .string \"%s\"\n", S_name(frags->head->u.stringg.label), frags->head->u.stringg.str);
+        snprintf(outfile, sizeof(outfile), "%s.s", file);
+        fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0 || !AS_writePieces(fd, pieces, n, mapOutput))
+            EM_error(0, "cannot write %s", outfile);
+        if (fd >= 0)
+            close(fd);
+    }
+    U_regionSwitch(prev);
+    U_regionReset(frontend);
+    return !anyErrors;
+}
+
+/* The input files: the file arguments, with "@list" standing for the
+ * whitespace-separated names in the file "list".  They and their names
+ * are kept in the permanent region. */
+static string *files;
+static int nfiles, maxfiles;
+
+static void addFile(string name)
+{
+    if (nfiles == maxfiles) {
+        string *old = files;
+        maxfiles = maxfiles ? 2 * maxfiles : 16;
+        files = U_regionAlloc(U_permanent(), maxfiles * sizeof(string));
+        if (nfiles)
+            memcpy(files, old, nfiles * sizeof(string));
+    }
+    files[nfiles++] = name;
+}
+
+static bool addResponseFile(string list)
+{
+    FILE *in = fopen(list, "r");
+    char name[1024];
+    if (!in)
+        return FALSE;
+    while (fscanf(in, "%1023s", name) == 1) {
+        U_region prev = U_regionSwitch(U_permanent());
+        addFile(String(name));
+        U_regionSwitch(prev);
+    }
+    fclose(in);
+    return TRUE;
+}
+
+int main(int argc, string *argv)
+{
+    bool memReport = FALSE, timeReport = FALSE, timeReportJson = FALSE;
+    bool cacheReport = FALSE;
+    string cacheDir = NULL;
+    long cacheSize = 64;
+    bool ok = TRUE, usage = FALSE;
+    string server = NULL;
+    int i, threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-fmem-report") == 0)
+            memReport = TRUE;
+        else if (strcmp(argv[i], "-ftime-report") == 0)
+            timeReport = TRUE;
+        else if (strcmp(argv[i], "-ftime-report=json") == 0)
+            timeReport = timeReportJson = TRUE;
+        else if (strcmp(argv[i], "-fregalloc=color") == 0)
+            regAlloc = RA_regAlloc;
+        else if (strcmp(argv[i], "-fregalloc=linear") == 0)
+            regAlloc = RA_linearScan;
+        else if (strncmp(argv[i], "-ftrace=", 8) == 0) {
+            if (!TR_enable(argv[i] + 8)) {
+                EM_error(0, "unknown trace channel in %s", argv[i]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "-ftrace-function=", 17) == 0)
+            TR_onlyFunction(argv[i] + 17);
+        else if (strncmp(argv[i], "-ftrace-file=", 13) == 0) {
+            if (!TR_file(argv[i] + 13)) {
+                EM_error(0, "cannot open %s", argv[i] + 13);
+                return 1;
             }
         }
-        fclose(out);
-        return 0;
+        else if (strncmp(argv[i], "-fcache=", 8) == 0)
+            cacheDir = argv[i] + 8;
+        else if (strncmp(argv[i], "-fcache-size=", 13) == 0 && atol(argv[i] + 13) > 0)
+            cacheSize = atol(argv[i] + 13);
+        else if (strcmp(argv[i], "-fcache-report") == 0)
+            cacheReport = TRUE;
+        else if (strcmp(argv[i], "-femit=mmap") == 0)
+            mapOutput = TRUE;
+        else if (strcmp(argv[i], "-femit=write") == 0)
+            mapOutput = FALSE;
+        else if (strcmp(argv[i], "-fobject") == 0)
+            objectOutput = TRUE;
+        else if (strcmp(argv[i], "--run") == 0)
+            runOutput = TRUE;
+        else if (strcmp(argv[i], "--interpret") == 0)
+            interpretOutput = TRUE;
+        else if (strcmp(argv[i], "-fgc") == 0)
+            F_gc = TRUE;
+        else if (strcmp(argv[i], "-fserver") == 0)
+            server = SV_defaultSocket();
+        else if (strncmp(argv[i], "-fserver=", 9) == 0)
+            server = argv[i] + 9;
+        else if (strncmp(argv[i], "-j", 2) == 0 && atoi(argv[i] + 2) > 0)
+            threads = atoi(argv[i] + 2);
+        else if (argv[i][0] == '@') {
+            if (!addResponseFile(argv[i] + 1)) {
+                EM_error(0, "cannot open %s", argv[i] + 1);
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-')
+            addFile(argv[i]);
+        else
+            usage = TRUE;
+    }
+
+    if (cacheDir && !CA_open(cacheDir, cacheSize << 20,
+                             regAlloc == RA_linearScan ? (F_gc ? "linear,gc" : "linear")
+                                                       : (F_gc ? "color,gc" : "color"))) {
+        EM_error(0, "cannot use %s as a cache", cacheDir);
+        return 1;
+    }
+    // the collector is runtime.c's, for programs assembled from .s
+    if (objectOutput + runOutput + interpretOutput > (server || F_gc ? 0 : 1))
+        usage = TRUE;
+    if (server && nfiles == 0 && !usage) {
+        // the machine registers and the pool are made once and kept warm
+        F_init();
+        startPool(threads > 0 ? threads : 1);
+        return SV_serve(server, compile);
+    }
+    if (nfiles > 0 && !server && !usage) {
+        if (timeReport)
+            TV_enable();
+        F_init();
+        startPool(threads > 0 ? threads : 1);
+        // one bad file does not stop the others
+        for (i = 0; i < nfiles; i++)
+            if (!compile(files[i], NULL, NULL))
+                ok = FALSE;
+        if (memReport)
+            U_regionReport(stderr);
+        if (cacheReport && cacheDir)
+            CA_report(stderr);
+        if (timeReport)
+            TV_report(stderr, timeReportJson);
+        return ok ? 0 : 1;
     }
-    EM_error(0, "usage: tiger file.tig");
+    EM_error(0, "usage: tiger [-jN] [-fmem-report] [-ftime-report[=json]] [-fregalloc=color|linear]\n"
+                "             [-femit=write|mmap] [-fobject | --run | --interpret | -fgc]\n"
+                "             [-ftrace=flowgraph,liveness,coloring,spill|all]\n"
+                "             [-ftrace-function=name]... [-ftrace-file=path]\n"
+                "             [-fcache=dir [-fcache-size=MB] [-fcache-report]] file.tig... | @list\n"
+                "       tiger [-jN] [-fregalloc=color|linear] [-fcache=dir...] -fserver[=socket]");
     return 1;
 }
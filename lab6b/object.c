@@ -0,0 +1,243 @@
+/*
+ * object.c - Relocatable ELF32 objects.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <elf.h>
+#include "util.h"
+#include "symbol.h"
+#include "table.h"
+#include "temp.h"
+#include "assem.h"
+#include "encode.h"
+#include "object.h"
+
+/* the sections, by their index in the section header table */
+enum {NULLSECT, TEXT, RODATA, RELTEXT, SYMTAB, STRTAB, SHSTRTAB, NOTESTACK, SECTIONS};
+
+static string sectionNames[SECTIONS] = {
+  "", ".text", ".rodata", ".rel.text", ".symtab", ".strtab", ".shstrtab",
+  ".note.GNU-stack"
+};
+
+struct symbol {
+  Temp_label name;
+  int section;          /* TEXT, RODATA or 0 for undefined */
+  unsigned value, size;
+  int index;            /* in .symtab, once it is laid out */
+};
+
+struct reloc {unsigned offset; int symbol; bool pcRelative;};
+
+/* syms and relocs hold arrays of the structs above; symbols maps a name
+ * to an int *, its place in syms.  The rest are for OBJ_write. */
+struct OBJ_object_ {
+  AS_buffer text, rodata, syms, relocs;
+  TAB_table symbols;
+  AS_buffer file, symtab, strtab, shstrtab, rel;
+};
+
+OBJ_object OBJ_Object(void)
+{OBJ_object o = U_regionAlloc(U_permanent(), sizeof(*o));
+ o->text = AS_Buffer();
+ o->rodata = AS_Buffer();
+ o->syms = AS_Buffer();
+ o->relocs = AS_Buffer();
+ o->symbols = NULL;
+ o->file = AS_Buffer();
+ o->symtab = AS_Buffer();
+ o->strtab = AS_Buffer();
+ o->shstrtab = AS_Buffer();
+ o->rel = AS_Buffer();
+ return o;
+}
+
+/* the table lives in the caller's region, which lasts for one file */
+void OBJ_reset(OBJ_object o)
+{
+ AS_bufferReset(o->text);
+ AS_bufferReset(o->rodata);
+ AS_bufferReset(o->syms);
+ AS_bufferReset(o->relocs);
+ o->symbols = TAB_empty();
+}
+
+#define SYMS(o) ((struct symbol *)(o)->syms->text)
+#define NSYMS(o) ((int)((o)->syms->length / sizeof(struct symbol)))
+
+static int symbol(OBJ_object o, Temp_label name)
+{int *i = TAB_look(o->symbols, name);
+ struct symbol s;
+ if (i) return *i;
+ i = checked_malloc(sizeof(*i));
+ *i = NSYMS(o);
+ s.name = name;
+ s.section = 0;
+ s.value = s.size = 0;
+ s.index = 0;
+ AS_write(o->syms, (char *)&s, sizeof(s));
+ TAB_enter(o->symbols, name, i);
+ return *i;
+}
+
+static void pad(AS_buffer b, size_t align)
+{
+ while (b->length % align)
+   AS_write(b, "", 1);
+}
+
+void OBJ_function(OBJ_object o, Temp_label name, char *code, size_t length,
+                  EN_reloc *relocs, int nrelocs)
+{struct symbol *s = &SYMS(o)[symbol(o, name)];
+ struct reloc r;
+ int i;
+ s->section = TEXT;
+ s->value = o->text->length;
+ s->size = length;
+ for (i = 0; i < nrelocs; i++) {
+   r.offset = o->text->length + relocs[i].offset;
+   r.symbol = symbol(o, relocs[i].sym);
+   r.pcRelative = relocs[i].pcRelative;
+   AS_write(o->relocs, (char *)&r, sizeof(r));
+ }
+ AS_write(o->text, code, length);
+}
+
+void OBJ_data(OBJ_object o, Temp_label name, char *bytes, size_t length)
+{struct symbol *s;
+ pad(o->rodata, 4);
+ s = &SYMS(o)[symbol(o, name)];
+ s->section = RODATA;
+ s->value = o->rodata->length;
+ s->size = length;
+ AS_write(o->rodata, bytes, length);
+}
+
+/* append "data" to the file as the contents of section "i" */
+static void contents(AS_buffer file, Elf32_Shdr *sh, int i, char *data, size_t length, size_t align)
+{
+ pad(file, align);
+ sh[i].sh_offset = file->length;
+ sh[i].sh_size = length;
+ sh[i].sh_addralign = align;
+ AS_write(file, data, length);
+}
+
+static unsigned addString(AS_buffer strtab, string s)
+{unsigned at = strtab->length;
+ AS_write(strtab, s, strlen(s) + 1);
+ return at;
+}
+
+bool OBJ_write(OBJ_object o, int fd)
+{AS_buffer file = o->file, symtab = o->symtab, strtab = o->strtab,
+           shstrtab = o->shstrtab, rel = o->rel;
+ Elf32_Shdr sh[SECTIONS];
+ Elf32_Ehdr eh;
+ AS_piece piece;
+ int i, n = NSYMS(o), locals = 2, index = 2, pass;
+
+ memset(sh, 0, sizeof(sh));
+ memset(&eh, 0, sizeof(eh));
+ AS_bufferReset(file);
+ AS_bufferReset(symtab);
+ AS_bufferReset(strtab);
+ AS_bufferReset(shstrtab);
+ AS_bufferReset(rel);
+ AS_write(file, (char *)&eh, sizeof(eh));      /* filled in at the end */
+ AS_write(strtab, "", 1);
+ AS_write(shstrtab, "", 1);
+ for (i = 0; i < SECTIONS; i++)
+   sh[i].sh_name = addString(shstrtab, sectionNames[i]);
+
+ /* the symbol table: the null symbol, .rodata's, then the locals, then
+  * the rest.  As with gas, ".L" names are left out. */
+ {Elf32_Sym sym;
+  memset(&sym, 0, sizeof(sym));
+  AS_write(symtab, (char *)&sym, sizeof(sym));
+  sym.st_info = ELF32_ST_INFO(STB_LOCAL, STT_SECTION);
+  sym.st_shndx = RODATA;
+  AS_write(symtab, (char *)&sym, sizeof(sym));
+  for (pass = 0; pass < 2; pass++)
+    for (i = 0; i < n; i++) {
+      struct symbol *s = &SYMS(o)[i];
+      bool local = s->section == RODATA;
+      if (local != (pass == 0)) continue;
+      if (local && !strncmp(S_name(s->name), ".L", 2)) continue;
+      sym.st_name = addString(strtab, S_name(s->name));
+      sym.st_value = s->value;
+      sym.st_size = s->size;
+      sym.st_info = local ? ELF32_ST_INFO(STB_LOCAL, STT_OBJECT)
+                  : s->section == TEXT ? ELF32_ST_INFO(STB_GLOBAL, STT_FUNC)
+                  : ELF32_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+      sym.st_other = STV_DEFAULT;
+      sym.st_shndx = s->section ? s->section : SHN_UNDEF;
+      AS_write(symtab, (char *)&sym, sizeof(sym));
+      s->index = index++;
+      if (local) locals++;
+    }
+ }
+ /* Data is reached through .rodata's symbol, so the addend in the code
+  * gets the data's place in .rodata added. */
+ for (i = 0; i < (int)(o->relocs->length / sizeof(struct reloc)); i++) {
+   struct reloc *r = (struct reloc *)o->relocs->text + i;
+   struct symbol *s = &SYMS(o)[r->symbol];
+   Elf32_Rel e;
+   e.r_offset = r->offset;
+   if (s->section == RODATA) {
+     unsigned char *p = (unsigned char *)o->text->text + r->offset;
+     unsigned v = (p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24) + s->value;
+     p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+     e.r_info = ELF32_R_INFO(1, r->pcRelative ? R_386_PC32 : R_386_32);
+   } else
+     e.r_info = ELF32_R_INFO(s->index, r->pcRelative ? R_386_PC32 : R_386_32);
+   AS_write(rel, (char *)&e, sizeof(e));
+ }
+
+ contents(file, sh, TEXT, o->text->text, o->text->length, 16);
+ sh[TEXT].sh_type = SHT_PROGBITS;
+ sh[TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+ contents(file, sh, RODATA, o->rodata->text, o->rodata->length, 4);
+ sh[RODATA].sh_type = SHT_PROGBITS;
+ sh[RODATA].sh_flags = SHF_ALLOC;
+ contents(file, sh, RELTEXT, rel->text, rel->length, 4);
+ sh[RELTEXT].sh_type = SHT_REL;
+ sh[RELTEXT].sh_link = SYMTAB;
+ sh[RELTEXT].sh_info = TEXT;
+ sh[RELTEXT].sh_entsize = sizeof(Elf32_Rel);
+ contents(file, sh, SYMTAB, symtab->text, symtab->length, 4);
+ sh[SYMTAB].sh_type = SHT_SYMTAB;
+ sh[SYMTAB].sh_link = STRTAB;
+ sh[SYMTAB].sh_info = locals;
+ sh[SYMTAB].sh_entsize = sizeof(Elf32_Sym);
+ contents(file, sh, STRTAB, strtab->text, strtab->length, 1);
+ sh[STRTAB].sh_type = SHT_STRTAB;
+ contents(file, sh, SHSTRTAB, shstrtab->text, shstrtab->length, 1);
+ sh[SHSTRTAB].sh_type = SHT_STRTAB;
+ /* an empty .note.GNU-stack: the stack need not be executable */
+ contents(file, sh, NOTESTACK, "", 0, 1);
+ sh[NOTESTACK].sh_type = SHT_PROGBITS;
+
+ pad(file, 4);
+ memcpy(eh.e_ident, ELFMAG, SELFMAG);
+ eh.e_ident[EI_CLASS] = ELFCLASS32;
+ eh.e_ident[EI_DATA] = ELFDATA2LSB;
+ eh.e_ident[EI_VERSION] = EV_CURRENT;
+ eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+ eh.e_type = ET_REL;
+ eh.e_machine = EM_386;
+ eh.e_version = EV_CURRENT;
+ eh.e_shoff = file->length;
+ eh.e_ehsize = sizeof(Elf32_Ehdr);
+ eh.e_shentsize = sizeof(Elf32_Shdr);
+ eh.e_shnum = SECTIONS;
+ eh.e_shstrndx = SHSTRTAB;
+ AS_write(file, (char *)sh, sizeof(sh));
+ memcpy(file->text, &eh, sizeof(eh));
+
+ piece.buffer = file;
+ piece.offset = 0;
+ piece.length = file->length;
+ return AS_writePieces(fd, &piece, 1, FALSE);
+}
@@ -0,0 +1,32 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+/*
+ * object.h - Relocatable ELF32 objects for i386, for -fobject.
+ *
+ * An object is built up from functions, which go into .text as global
+ * symbols, and read-only data such as string literals, which go into
+ * .rodata as local ones.  A relocation against a symbol the object does
+ * not define makes an undefined symbol, for the linker to find in the
+ * runtime.
+ */
+
+typedef struct OBJ_object_ *OBJ_object;
+
+/* An empty object, kept (with its memory) for the life of the compiler */
+OBJ_object OBJ_Object(void);
+
+/* Empty "o" for the next file */
+void OBJ_reset(OBJ_object o);
+
+/* The function "name": "length" bytes of code with "nrelocs" relocations,
+ * their offsets from the start of the code */
+void OBJ_function(OBJ_object o, Temp_label name, char *code, size_t length,
+                  EN_reloc *relocs, int nrelocs);
+
+/* Read-only data "name": "length" bytes, aligned to a word */
+void OBJ_data(OBJ_object o, Temp_label name, char *bytes, size_t length);
+
+/* Write "o" to "fd"; FALSE if it cannot */
+bool OBJ_write(OBJ_object o, int fd);
+
+#endif
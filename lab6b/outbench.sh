@@ -0,0 +1,67 @@
+#!/bin/bash
+# Time programs that print a lot: queens.tig, and a loop of printi and
+# print.  Each is linked with runtime.c and run with its output going to
+# a file, once as it is and once with TIGER_LINEBUF set.  With BASE set
+# to an older runtime.c, the program linked with that is timed too.
+#   ./outbench.sh            (N=n, ROUNDS=n, BASE=path/to/runtime.c)
+
+BIN=${BIN:-./a.out}
+TESTCASEDIR=./testcases
+N=${N:-200000}
+ROUNDS=${ROUNDS:-5}
+
+if [[ $BIN == ./a.out ]]; then
+	make >& /dev/null
+	if [[ $? != 0 ]]; then
+		echo "Compile Error"
+		exit 123
+	fi
+fi
+BIN=$(cd $(dirname $BIN) && pwd)/$(basename $BIN)
+[[ -n $BASE ]] && BASE=$(cd $(dirname $BASE) && pwd)/$(basename $BASE)
+RUNTIME=$(pwd)/runtime.c
+
+WORKDIR=$(mktemp -d)
+cp $TESTCASEDIR/queens.tig $WORKDIR
+cd $WORKDIR
+
+cat > prints.tig <<EOF
+for i := 1 to $N do
+  (printi(i);
+   if i - i / 10 * 10 = 0 then print("\n") else print(" "))
+EOF
+
+# build $2.tig.s, linked with runtime $1, into $3
+build() {
+	gcc -Wl,--wrap,getchar -m32 $2.tig.s $1 -o $3 >& /dev/null
+}
+
+# milliseconds per run of $1, its output in out.txt
+runTime() {
+	local start end i
+	start=$(date +%s%N)
+	for ((i = 0; i < ROUNDS; i++)); do
+		./$1 < /dev/null > out.txt
+	done
+	end=$(date +%s%N)
+	awk "BEGIN { printf \"%.1f\", ($end - $start) / $ROUNDS / 1000000 }"
+}
+
+printf "%-12s %10s %10s %10s %12s %10s\n" program "KB out" "ms" "MB/s" "linebuf ms" "base ms"
+for prog in queens prints; do
+	if ! $BIN $prog.tig >& /dev/null || ! build $RUNTIME $prog $prog; then
+		echo "$prog: Compile Error"
+		continue
+	fi
+	time=$(runTime $prog)
+	bytes=$(wc -c < out.txt)
+	rate=$(awk "BEGIN { printf \"%.1f\", ($time > 0 ? $bytes / $time / 1000 : 0) }")
+	line=$(TIGER_LINEBUF=1 runTime $prog)
+	base=-
+	if [[ -n $BASE ]] && build $BASE $prog $prog.base; then
+		base=$(runTime $prog.base)
+	fi
+	printf "%-12s %10d %10s %10s %12s %10s\n" $prog $((bytes / 1024)) $time $rate $line $base
+done
+cd - > /dev/null
+rm -rf $WORKDIR
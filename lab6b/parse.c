@@ -16,14 +16,33 @@
 #include "semant.h"
 
 extern int yyparse(void);
+extern void lexReset(FILE *);
+extern FILE *yyin;
 extern A_exp absyn_root;
 
+static A_exp parseInput(void)
+{int failed;
+ if (!yyin) return NULL;
+ lexReset(yyin);
+ failed = yyparse();
+ fclose(yyin);
+ yyin = NULL;
+ if (!failed) /* parsing worked */
+   return absyn_root;
+ else return NULL;
+}
+
 /* parse source file fname; 
    return abstract syntax data structure */
 A_exp parse(string fname) 
 {EM_reset(fname);
- if (yyparse() == 0) /* parsing worked */
-   return absyn_root;
- else return NULL;
+ return parseInput();
+}
+
+/* the same for source read from "in", which is closed afterwards;
+   fname names it in error messages */
+A_exp parseStream(string fname, FILE *in)
+{EM_resetStream(fname, in);
+ return parseInput();
 }
 
@@ -1,3 +1,4 @@
 /* function prototype from parse.c */
 A_exp parse(string fname);
+A_exp parseStream(string fname, FILE *in);
 
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Compare the graph-coloring and linear-scan register allocators over the
+# testcases: average compile time and the number of instructions emitted.
+#   ./rabench.sh            (ROUNDS=n to change the number of runs per case)
+
+BIN=${BIN:-./a.out}
+TESTCASEDIR=./testcases
+ROUNDS=${ROUNDS:-20}
+
+if [[ $BIN == ./a.out ]]; then
+	make >& /dev/null
+	if [[ $? != 0 ]]; then
+		echo "Compile Error"
+		exit 123
+	fi
+fi
+BIN=$(cd $(dirname $BIN) && pwd)/$(basename $BIN)
+
+# compile in a scratch directory, away from the .s files in testcases
+WORKDIR=$(mktemp -d)
+cp $TESTCASEDIR/*.tig $WORKDIR
+cd $WORKDIR
+
+# milliseconds per compile of $2 with -fregalloc=$1
+compileTime() {
+	local start end i
+	start=$(date +%s%N)
+	for ((i = 0; i < ROUNDS; i++)); do
+		$BIN -fregalloc=$1 $2 >& /dev/null
+	done
+	end=$(date +%s%N)
+	awk "BEGIN { printf \"%.2f\", ($end - $start) / $ROUNDS / 1000000 }"
+}
+
+# instructions in the last .s emitted for $1
+instructions() {
+	grep -av ':' $1.s | grep -ac '^[a-z]'
+}
+
+printf "%-12s %12s %12s %12s %12s\n" testcase "color ms" "linear ms" "color instr" "linear instr"
+for tcase in *.tig; do
+	ctime=$(compileTime color $tcase)
+	cins=$(instructions $tcase)
+	ltime=$(compileTime linear $tcase)
+	lins=$(instructions $tcase)
+	printf "%-12s %12s %12s %12s %12s\n" $tcase $ctime $ltime $cins $lins
+done
+cd - > /dev/null
+rm -rf $WORKDIR
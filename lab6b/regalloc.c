@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "util.h"
 #include "symbol.h"
 #include "temp.h"
@@ -12,11 +13,15 @@
 #include "regalloc.h"
 #include "table.h"
 #include "flowgraph.h"
+#include "timevar.h"
+#include "trace.h"
 
-void printTemp_tempList(Temp_tempList list) {
-    for(; list; list = list->tail) {
-        printf("reg number:%d\n", getTempNum(list->head));
-    }
+// the temp that "t" was renamed to, by parallel lists olds -> news
+static Temp_temp renamedTemp(Temp_tempList olds, Temp_tempList news, Temp_temp t) {
+    for(; olds; olds = olds->tail, news = news->tail)
+        if(olds->head == t)
+            return news->head;
+    return NULL;
 }
 
 void rewriteProgram(F_frame f, Temp_tempList spills, AS_instrList il) {
@@ -30,6 +35,8 @@ void rewriteProgram(F_frame f, Temp_tempList spills, AS_instrList il) {
         assert(access == NULL);
         access = F_allocLocal(f, TRUE);
         TAB_enter(reg2access, tSpills->head, access);
+        TR_printf(TR_SPILL, "spill t%d to %d(%%ebp)\n", getTempNum(tSpills->head),
+                  F_accessOffset(access)*F_wordSize);
     }
 
     for(; il; il = il->tail) {
@@ -37,27 +44,31 @@ void rewriteProgram(F_frame f, Temp_tempList spills, AS_instrList il) {
         if(instr->kind != I_LABEL) {
             Temp_tempList dst, src;
             if(instr->kind == I_MOVE) {
-                printf("instr:%s\n", instr->u.MOVE.assem);
                 dst = instr->u.MOVE.dst;
                 src = instr->u.MOVE.src;
             } else {
-                printf("instr:%s\n", instr->u.OPER.assem);
                 dst = instr->u.OPER.dst;
                 src = instr->u.OPER.src;
             }
-            printf("src:\n");
-            printTemp_tempList(src);
-            printf("dst:\n");
-            printTemp_tempList(dst);
+            // every spilled temp of the instruction gets one new temp,
+            // shared by its uses and defs there: two-address instructions
+            // read and write the same operand
+            Temp_tempList olds = NULL, news = NULL;
             for(; src; src = src->tail) {
                 F_access access = TAB_look(reg2access, src->head);
                 if(access == NULL)
                     continue;
-                printf("reg : number%d\n", getTempNum(src->head));
-                Temp_temp r = Temp_newtemp();
-                printf("new load\n");
+                Temp_temp r = renamedTemp(olds, news, src->head);
+                if(r != NULL) {
+                    src->head = r;
+                    continue;
+                }
+                r = Temp_newtemp();
+                olds = Temp_TempList(src->head, olds);
+                news = Temp_TempList(r, news);
+                TR_printf(TR_SPILL, "load t%d into t%d\n", getTempNum(src->head), getTempNum(r));
                 AS_instr newInstr = AS_Oper(
-                        createString("movl %d(`s0), `d0\n", F_accessOffset(access)*F_wordSize),
+                        AS_Code(AS_MOVL, AS_Disp(F_accessOffset(access)*F_wordSize, 0), AS_Dst(0)),
                         Temp_TempList(r, NULL), Temp_TempList(F_FP(), NULL), NULL);
                 src->head = r;
                 pre->tail = AS_InstrList(newInstr, pre->tail);
@@ -67,10 +78,17 @@ void rewriteProgram(F_frame f, Temp_tempList spills, AS_instrList il) {
                 F_access access = TAB_look(reg2access, dst->head);
                 if(access == NULL)
                     continue;
-                printf("new move\n");
+                Temp_temp r = renamedTemp(olds, news, dst->head);
+                if(r == NULL) {
+                    r = Temp_newtemp();
+                    olds = Temp_TempList(dst->head, olds);
+                    news = Temp_TempList(r, news);
+                }
+                TR_printf(TR_SPILL, "store t%d from t%d\n", getTempNum(dst->head), getTempNum(r));
+                dst->head = r;
                 //MOVE(MEM(e1 + CONST), e2)
-                AS_instr newInstr = AS_Oper(createString("movl `s1, %d(`s0)\n", F_accessOffset(access)*F_wordSize),
-                    NULL, Temp_TempList(F_FP(), Temp_TempList(dst->head, NULL)), NULL);
+                AS_instr newInstr = AS_Oper(AS_Code(AS_MOVL, AS_Src(1), AS_Disp(F_accessOffset(access)*F_wordSize, 0)),
+                    NULL, Temp_TempList(F_FP(), Temp_TempList(r, NULL)), NULL);
                 il->tail = AS_InstrList(newInstr, il->tail);
                 il = il->tail;
             }
@@ -100,60 +118,50 @@ void removeUselessMoves(AS_instrList il, Temp_map color) {
     }
 }
 
-FILE* out = NULL;
-
-void show(void* t) {
-    Temp_temp m = (Temp_temp) t;
-    fprintf(out, "tmp:%d", getTempNum(m));
+// one line of the liveness trace: the temp of an interference graph node
+static void showTemp(void* t) {
+    fprintf(TR_out, "t%d", getTempNum((Temp_temp) t));
 }
 
-void showflow(void* t) {
-    NodeInfo m = (NodeInfo) t;
-    AS_instr instr = m->instr;
-    char *s;
-    switch(instr->kind) {
-        case I_LABEL:
-            s = S_name(instr->u.LABEL.label);
-        break;
-        case I_MOVE:
-            s = instr->u.MOVE.assem;
-        break;
-        case I_OPER:
-            s = instr->u.OPER.assem;
-        break;
-    }
-    fprintf(out, "instr:%s:", s);
+// the program after a round of spilling, for the spill trace
+static void traceRewrite(F_frame f, Temp_tempList spills, AS_instrList il) {
+    fprintf(TR_out, "rewrote %s for", S_name(F_name(f)));
+    for(; spills; spills = spills->tail)
+        fprintf(TR_out, " t%d", getTempNum(spills->head));
+    fprintf(TR_out, ":\n");
+    AS_printInstrList(TR_out, il, Temp_layerMap(F_tempMap, Temp_name()));
 }
 
-FILE *instrOut = NULL;
+// length of a Temp_tempList, for the time report
+static int tempCount(Temp_tempList l) {
+    int n = 0;
+    for(; l; l = l->tail)
+        n++;
+    return n;
+}
 
 struct RA_result RA_regAlloc(F_frame f, AS_instrList il) {
+    TV_start(TV_FLOWGRAPH);
     G_graph flowGraph = FG_AssemFlowGraph(il, f);
-
-    if(out == NULL)
-        out = fopen("my.txt", "w");
-    if(instrOut == NULL)
-        instrOut = fopen("my-instr.txt", "w");
-
-    fprintf(instrOut, "----------------------%s-----------------------\n", S_name(F_name(f)));
-    fprintf(instrOut, "------------------------------\n");
-    Temp_dumpMap(instrOut, F_preColored());
-    fprintf(instrOut, "------------------------------\n");
-    AS_printInstrList(instrOut, il, Temp_layerMap(F_tempMap, Temp_name()));
-    fprintf(instrOut, "--------------------------------!@#!@#!@#\n");
+    TV_stop(TV_FLOWGRAPH, G_nodesNumber(flowGraph));
 
     // G_show(out, G_nodes(flowGraph), NULL);
     assert(flowGraph);
+    TV_start(TV_LIVENESS);
     struct Live_graph lg = Live_liveness(flowGraph);
+    TV_stop(TV_LIVENESS, G_nodesNumber(lg.graph));
 
-    if(strcmp(S_name(F_name(f)), "isdigit") == 0) {
-        fprintf(out, "----------------------%s-----------------------\n", S_name(F_name(f)));
-        G_show(out, G_nodes(lg.graph), show);
+    if(TR_on(TR_LIVENESS)) {
+        fprintf(TR_out, "interference graph of %s: %d temps\n",
+                S_name(F_name(f)), G_nodesNumber(lg.graph));
+        G_show(TR_out, G_nodes(lg.graph), showTemp);
     }
 
     Temp_map initial = Temp_layerMap(F_tempMap, F_preColored());
     Temp_tempList regs = F_registers();
+    TV_start(TV_COLOR);
     struct COL_result colorResult = COL_color(lg, initial, regs);
+    TV_stop(TV_COLOR, tempCount(colorResult.spills));
 
     // fprintf(out, "------------------------------\n");
     // AS_printInstrList(out, il, 
@@ -162,7 +170,11 @@ struct RA_result RA_regAlloc(F_frame f, AS_instrList il) {
 
     if(colorResult.spills != NULL) {
         // printf("rewrite\n");
+        TV_start(TV_REWRITE);
         rewriteProgram(f, colorResult.spills, il);
+        TV_stop(TV_REWRITE, tempCount(colorResult.spills));
+        if(TR_on(TR_SPILL))
+            traceRewrite(f, colorResult.spills, il);
         // printf("rewrite complete\n");
         return RA_regAlloc(f, il);
     }  
@@ -172,3 +184,123 @@ struct RA_result RA_regAlloc(F_frame f, AS_instrList il) {
 }
 
 
+/* Linear scan */
+
+static int compareStart(const void *a, const void *b) {
+    Live_interval x = *(Live_interval *)a, y = *(Live_interval *)b;
+    if(x->start != y->start)
+        return x->start - y->start;
+    return x->end - y->end;
+}
+
+// machine register "reg" is not live anywhere in [start, end]
+static bool registerFree(Live_interval reg, int start, int end) {
+    int i;
+    if(reg == NULL || reg->cover == NULL)
+        return TRUE;
+    i = Bit_next(reg->cover, start);
+    return i < 0 || i > end;
+}
+
+// Poletto & Sarkar's linear scan over whole live ranges.  Temps are taken
+// in order of their start; "active" holds the ones currently in a register,
+// by register.  A machine register is only handed out where it is not
+// itself live, which keeps temps out of %eax/%ecx/%edx across calls and
+// away from registers an instruction uses implicitly.  When no register
+// fits, the range ending last among the candidates is spilled.
+static Temp_tempList linearScan(Live_interval *iv, int n, Temp_map initial,
+                                Temp_tempList regs, Temp_map colorMap) {
+    int i, j, k, K = 0, ntemps = 0;
+    Live_interval *temps = checked_malloc(n * sizeof(Live_interval));
+    Live_interval *fixed, *active;
+    Temp_temp *reg;
+    Temp_tempList spills = NULL, l;
+
+    for(l = regs; l; l = l->tail)
+        K++;
+    reg = checked_malloc(K * sizeof(Temp_temp));
+    fixed = checked_malloc(K * sizeof(Live_interval));
+    active = checked_malloc(K * sizeof(Live_interval));
+    for(k = 0, l = regs; l; l = l->tail, ++k) {
+        reg[k] = l->head;
+        fixed[k] = NULL;
+        active[k] = NULL;
+    }
+
+    for(i = 0; i < n; ++i) {
+        if(Temp_look(initial, iv[i]->temp) == NULL) {
+            if(iv[i]->start <= iv[i]->end)
+                temps[ntemps++] = iv[i];
+        } else {
+            for(k = 0; k < K; ++k)
+                if(reg[k] == iv[i]->temp)
+                    fixed[k] = iv[i];
+        }
+    }
+    qsort(temps, ntemps, sizeof(Live_interval), compareStart);
+
+    for(i = 0; i < ntemps; ++i) {
+        Live_interval cur = temps[i];
+        int victim = -1;
+        for(k = 0; k < K; ++k)
+            if(active[k] && active[k]->end < cur->start)
+                active[k] = NULL;
+        for(k = 0; k < K; ++k)
+            if(active[k] == NULL && registerFree(fixed[k], cur->start, cur->end))
+                break;
+        if(k == K) {
+            // take the register of the active range that ends last, if it
+            // outlives this one and its register would suit this one
+            for(j = 0; j < K; ++j)
+                if(active[j] && active[j]->end > cur->end
+                    && registerFree(fixed[j], cur->start, cur->end)
+                    && (victim < 0 || active[j]->end > active[victim]->end))
+                    victim = j;
+            if(victim < 0) {
+                spills = Temp_TempList(cur->temp, spills);
+                continue;
+            }
+            spills = Temp_TempList(active[victim]->temp, spills);
+            k = victim;
+        }
+        active[k] = cur;
+        Temp_enter(colorMap, cur->temp, Temp_look(initial, reg[k]));
+    }
+    return spills;
+}
+
+struct RA_result RA_linearScan(F_frame f, AS_instrList il) {
+    for(;;) {
+        TV_start(TV_FLOWGRAPH);
+        G_graph flowGraph = FG_AssemFlowGraph(il, f);
+        TV_stop(TV_FLOWGRAPH, G_nodesNumber(flowGraph));
+        Temp_map initial = Temp_layerMap(F_tempMap, F_preColored());
+        Temp_map coloring = Temp_layerMap(Temp_empty(), initial);
+        int n;
+        TV_start(TV_LIVENESS);
+        Live_interval *iv = Live_intervals(flowGraph, F_registers(), &n);
+        TV_stop(TV_LIVENESS, n);
+        if(TR_on(TR_LIVENESS)) {
+            int i;
+            fprintf(TR_out, "live intervals of %s: %d temps\n", S_name(F_name(f)), n);
+            for(i = 0; i < n; ++i)
+                fprintf(TR_out, "t%d [%d, %d]\n", getTempNum(iv[i]->temp), iv[i]->start, iv[i]->end);
+        }
+        TV_start(TV_LINEAR_SCAN);
+        Temp_tempList spills = linearScan(iv, n, initial, F_registers(), coloring);
+        TV_stop(TV_LINEAR_SCAN, tempCount(spills));
+        if(spills == NULL) {
+            struct RA_result ret;
+            removeUselessMoves(il, coloring);
+            ret.coloring = coloring;
+            ret.il = il;
+            return ret;
+        }
+        TV_start(TV_REWRITE);
+        rewriteProgram(f, spills, il);
+        TV_stop(TV_REWRITE, tempCount(spills));
+        if(TR_on(TR_SPILL))
+            traceRewrite(f, spills, il);
+    }
+}
+
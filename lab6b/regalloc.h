@@ -10,5 +10,9 @@ struct RA_result {
 
 struct RA_result RA_regAlloc(F_frame f, AS_instrList il);
 
+/* Allocate registers by linear scan over live ranges instead of graph
+ * coloring: much faster, but the code it produces is worse. */
+struct RA_result RA_linearScan(F_frame f, AS_instrList il);
+
 
 #endif
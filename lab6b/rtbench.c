@@ -0,0 +1,204 @@
+/*
+ * rtbench.c - Time runtime.c's string and array primitives in each
+ *             version of their loops that this CPU can run: stringEqual
+ *             on equal strings, initArray, and (one version each, as
+ *             they go to libc) concat, substring and allocRecord; and a
+ *             string built up one character at a time by concat, left
+ *             as a rope until the end or put together at every step.
+ *             Then, as -fgc programs run, a check that stringEqual keeps
+ *             both its strings through a collection.
+ *
+ *             make rtbench && ./rtbench
+ */
+
+#define main runtimeMain
+#include "runtime.c"
+#undef main
+
+#include <assert.h>
+
+int tigermain(int staticLink)
+{
+ return 0;
+}
+
+static struct {
+  char *name;
+  int (*equal)(unsigned char *s, unsigned char *t, int n);
+  void (*fill)(int *a, int v, int n);
+  int runs;
+} kernels[] = {
+  {"scalar", equalScalar, fillScalar, 1},
+#if defined(__i386__) || defined(__x86_64__)
+  {"sse2", equalSSE2, fillSSE2, 0},
+  {"avx2", equalAVX2, fillAVX2, 0},
+#endif
+};
+
+#define KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static int sizes[] = {8, 64, 1024, 65536};
+
+#define SIZES ((int)(sizeof(sizes) / sizeof(sizes[0])))
+
+/* putting a string together at every step is quadratic; keep it short */
+static int appendSizes[] = {64, 1024, 4096};
+
+#define APPENDSIZES ((int)(sizeof(appendSizes) / sizeof(appendSizes[0])))
+
+/* each timing does about this many bytes of work */
+#define WORK (256 << 20)
+
+static double seconds(clock_t start)
+{
+ return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static struct string *makeString(int n, int c)
+{struct string *s = malloc(sizeof(int) + n);
+ s->length = n;
+ memset(s->chars, c, n);
+ return s;
+}
+
+/* give back what the last calls bumped out of the current chunk */
+static void resetHeap(void)
+{
+ tiger_avail = run;
+}
+
+static void report(char *what, char *version, int n, long calls, double t)
+{
+ printf("%-12s %-8s %8d   %9.1f ns/call   %8.2f GB/s\n", what, version, n,
+        t * 1e9 / calls, t > 0 ? (double)n * calls / t / 1e9 : 0.0);
+}
+
+static void benchEqual(int k, int n)
+{struct string *s = makeString(n, 'x'), *t = makeString(n, 'x');
+ long calls = WORK / n, i, equal = 0;
+ clock_t start;
+ equalChars = kernels[k].equal;
+ start = clock();
+ for (i = 0; i < calls; i++) equal += stringEqual(s, t);
+ report("stringEqual", kernels[k].name, n, calls, seconds(start));
+ assert(equal == calls);
+ free(s);
+ free(t);
+}
+
+static void benchFill(int k, int n)
+{long calls = WORK / (n * sizeof(int)), i, sum = 0;
+ clock_t start;
+ fillWords = kernels[k].fill;
+ start = clock();
+ for (i = 0; i < calls; i++) {
+   sum += initArray(n, (int)i)[n - 1];
+   resetHeap();
+ }
+ report("initArray", kernels[k].name, n * sizeof(int), calls, seconds(start));
+ assert(sum == (calls - 1) * calls / 2);
+}
+
+static void benchCopies(int n)
+{struct string *a = makeString(n, 'a'), *b = makeString(n, 'b');
+ long calls = WORK / (2 * n), i, sum = 0;
+ clock_t start = clock();
+ for (i = 0; i < calls; i++) {
+   sum += flat(concat(a, b))->chars[n];
+   resetHeap();
+ }
+ report("concat", "libc", 2 * n, calls, seconds(start));
+ assert(sum == 'b' * calls);
+
+ calls = WORK / n;
+ start = clock();
+ for (i = 0; i < calls; i++) {
+   sum += substring(a, 0, n)->length;
+   resetHeap();
+ }
+ report("substring", "libc", n, calls, seconds(start));
+
+ calls = WORK / n;
+ start = clock();
+ for (i = 0; i < calls; i++) {
+   sum += allocRecord(n)[0];
+   resetHeap();
+ }
+ report("allocRecord", "libc", n, calls, seconds(start));
+ free(a);
+ free(b);
+}
+
+static void benchAppend(int n)
+{struct string *letters[26];
+ int copy, k;
+ for (k = 0; k < 26; k++) letters[k] = makeString(1, 'a' + k);
+ for (copy = 0; copy < 2; copy++) {
+   long calls = copy ? 1 + (WORK >> 10) / ((long)n * n) : 1 + (WORK >> 4) / n, i, j;
+   long sum = 0;
+   clock_t start = clock();
+   for (i = 0; i < calls; i++) {
+     struct string *s = letters[0];
+     for (j = 1; j < n; j++) {
+       s = concat(s, letters[j % 26]);
+       if (copy) s = flat(s);
+     }
+     sum += flat(s)->chars[n - 1];
+     resetHeap();
+   }
+   report("append", copy ? "copy" : "rope", n, calls, seconds(start));
+   assert(sum == ('a' + (n - 1) % 26) * calls);
+ }
+ for (k = 0; k < 26; k++) free(letters[k]);
+}
+
+/* stringEqual on two ropes, with the heap so full that putting the first
+ * together collects: the second, which only stringEqual holds, must
+ * survive it */
+static void checkCollectingEqual(void)
+{static struct tiger_map map = {1, 0};
+ static char frame[16];
+ struct string *half = makeString(20, 'x'), *s, *t;
+ unsigned node = (sizeof(int) + sizeof(struct rope) + 3) & ~3u;
+ unsigned flatSize = (2 * sizeof(int) + 40 + 3) & ~3u;
+ long collections;
+ /* a frame with an empty map, and a 1MB heap collected when it fills */
+ *(struct tiger_map **)(frame + 4) = &map;
+ tiger_frame = frame + 8;
+ run = tiger_avail = tiger_limit = NULL;
+ setenv("TIGER_HEAP", "1", 1);
+ allocRecord(4);
+ while ((unsigned)(tiger_limit - tiger_avail) >= 2 * node + flatSize)
+   allocRecord(4);
+ s = concat(half, half);
+ t = concat(half, half);
+ assert(size(s) == 40 && size(t) == 40 && tiger_limit - tiger_avail < flatSize);
+ collections = stats.collections;
+ assert(stringEqual(s, t));
+ assert(stats.collections == collections + 1);
+ printf("%-12s %-8s %8d   keeps both ropes through a collection\n",
+        "stringEqual", "gc", 40);
+ tiger_frame = NULL;
+ free(half);
+}
+
+int main(void)
+{int k, i;
+#if defined(__i386__) || defined(__x86_64__)
+ __builtin_cpu_init();
+ kernels[1].runs = __builtin_cpu_supports("sse2");
+ kernels[2].runs = __builtin_cpu_supports("avx2");
+#endif
+ for (k = 0; k < KERNELS; k++) {
+   if (!kernels[k].runs) {
+     printf("%-12s %-8s not supported here\n", "", kernels[k].name);
+     continue;
+   }
+   for (i = 0; i < SIZES; i++) benchEqual(k, sizes[i]);
+   for (i = 0; i < SIZES; i++) benchFill(k, sizes[i]);
+ }
+ for (i = 0; i < SIZES; i++) benchCopies(sizes[i]);
+ for (i = 0; i < APPENDSIZES; i++) benchAppend(appendSizes[i]);
+ checkCollectingEqual();
+ return 0;
+}
@@ -2,48 +2,450 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
+/* The heap.  Objects are bumped out of [tiger_avail, tiger_limit): by
+ * the code the compiler emits inline for records and arrays, and by
+ * alloc, which that code calls (through allocRecord and initArray) when
+ * the space left is too small.  An object is preceded by a header word:
+ * twice its size in bytes, header included, a multiple of 4; its kind;
+ * and the mark bit.
+ *
+ * A program compiled with -fgc stores its frame pointer in tiger_frame
+ * before each call that may allocate, and each of its frames keeps a
+ * map of the slots that may hold pointers; it bumps through the free
+ * runs of a heap that is marked and swept when it fills.  Other
+ * programs leave tiger_frame NULL and are given chunks from malloc.
+ *
+ * Free runs have headers too, so the heap can be walked from end to
+ * end, and a bit per word in "starts" says where the headers are; those
+ * of the objects bumped out of a run are set when the run is left.  A
+ * word is taken as a pointer if it points into an object, so a stale or
+ * derived pointer in a frame or a record only keeps an object alive. */
 
-int *initArray(int size, int init)
+char *tiger_frame;
+char *tiger_avail, *tiger_limit;
+
+/* as -fgc emits it; each frame has its own at -4(%ebp) */
+struct tiger_map {int outermost; int n; int offsets[1];};
+
+enum {FREE, SCAN, NOSCAN};
+#define KIND 3
+#define MARK 4
+#define HEADER(h) (*(unsigned *)(h))
+#define SIZE(h) ((HEADER(h) & ~7u) >> 1)
+#define CHUNK (1 << 20)
+
+static char *heapStart, *heapEnd;
+static char *run;                       /* where tiger_avail started */
+static char *runs;                      /* free runs, linked at +4 */
+static unsigned *starts;
+static char **marking;
+static int nmarking, maxmarking;
+
+/* what the runtime holds while it allocates */
+static void *roots[4];
+static int nroots;
+
+static struct {
+  long collections, allocated, freed, live;
+  clock_t pause, maxPause;
+} stats;
+
+/* What print and printi write is held here until flush, getchar or exit
+ * or until it fills, rather than written a call at a time; with
+ * $TIGER_LINEBUF set, a print of a newline flushes too. */
+#define OUTPUT (1 << 16)
+
+static char output[OUTPUT];
+static int noutput, lineBuffered;
+
+void flush()
+{
+ fwrite(output, 1, noutput, stdout);
+ noutput = 0;
+ fflush(stdout);
+}
+
+static void put(unsigned char *p, int n)
+{int newline = lineBuffered && memchr(p, '\n', n);
+ if (n > OUTPUT - noutput) {
+   flush();
+   if (n > OUTPUT) {
+     fwrite(p, 1, n, stdout);
+     n = 0;
+   }
+ }
+ memcpy(output + noutput, p, n);
+ noutput += n;
+ if (newline) flush();
+}
+
+static void outOfMemory(void)
+{
+ flush();
+ printf("out of memory\n");
+ exit(1);
+}
+
+static void setStart(char *h, int on)
+{unsigned i = (h - heapStart) / 4;
+ if (on) starts[i/32] |= 1u << i%32;
+ else starts[i/32] &= ~(1u << i%32);
+}
+
+/* the heap's size in MB is $TIGER_HEAP, 64 by default */
+static void initHeap(void)
+{char *e = getenv("TIGER_HEAP");
+ unsigned long size = (e && atol(e) > 0 && atol(e) < 2048 ? atol(e) : 64) << 20;
+ char *p = malloc(size + 8);
+ starts = calloc(size / 4 / 32 + 1, sizeof(unsigned));
+ if (!p || !starts) outOfMemory();
+ heapStart = (char *)(((unsigned long)p + 7) & ~7ul);
+ heapEnd = heapStart + size;
+ HEADER(heapStart) = 2 * size | FREE;
+ setStart(heapStart, 1);
+ runs = heapStart;
+ *(char **)(runs + 4) = NULL;
+}
+
+/* the header of the object "p" points into, or NULL; an empty record or
+ * array is only its header, and points just past it */
+static char *object(char *p)
+{unsigned i, w, bits;
+ char *h;
+ if (p < heapStart + 4 || p >= heapEnd) return NULL;
+ i = (p - 4 - heapStart) / 4;
+ w = i / 32;
+ bits = starts[w] & (~0u >> (31 - i%32));
+ while (!bits) {
+   if (w == 0) return NULL;
+   bits = starts[--w];
+ }
+ h = heapStart + 4 * (32*w + 31 - __builtin_clz(bits));
+ if ((HEADER(h) & KIND) == FREE || p > h + SIZE(h) || (p == h + SIZE(h) && SIZE(h) > 4))
+   return NULL;
+ return h;
+}
+
+static void mark(char *p)
+{char *h = object(p);
+ if (!h || HEADER(h) & MARK) return;
+ HEADER(h) |= MARK;
+ stats.live += SIZE(h);
+ if ((HEADER(h) & KIND) != SCAN) return;
+ if (nmarking == maxmarking) {
+   maxmarking = maxmarking ? 2 * maxmarking : 1024;
+   if (!(marking = realloc(marking, maxmarking * sizeof(char *)))) outOfMemory();
+ }
+ marking[nmarking++] = h;
+}
+
+static void markAll(void)
+{char *fp = tiger_frame, *h, *p;
+ int i;
+ for (;;) {
+   struct tiger_map *m = *(struct tiger_map **)(fp - 4);
+   for (i = 0; i < m->n; i++)
+     mark(*(char **)(fp + m->offsets[i]));
+   if (m->outermost) break;
+   fp = *(char **)fp;
+ }
+ for (i = 0; i < nroots; i++)
+   mark(roots[i]);
+ while (nmarking) {
+   h = marking[--nmarking];
+   for (p = h + 4; p < h + SIZE(h); p += 4)
+     mark(*(char **)p);
+ }
+}
+
+/* unmark the live objects, and merge the rest into free runs; a run of
+ * one word has no room for the link, and waits for its neighbours */
+static void sweep(void)
+{char *h, *free = NULL, **last = &runs;
+ unsigned size;
+ for (h = heapStart; h < heapEnd; h += size) {
+   size = SIZE(h);
+   if (HEADER(h) & MARK) {
+     HEADER(h) &= ~MARK;
+     if (free && SIZE(free) >= 8) {
+       *last = free;
+       last = (char **)(free + 4);
+     }
+     free = NULL;
+     continue;
+   }
+   if ((HEADER(h) & KIND) != FREE)
+     stats.freed += size;
+   if (free) {
+     setStart(h, 0);
+     HEADER(free) += 2 * size;
+   } else {
+     free = h;
+     HEADER(h) = 2 * size | FREE;
+   }
+ }
+ if (free && SIZE(free) >= 8) {
+   *last = free;
+   last = (char **)(free + 4);
+ }
+ *last = NULL;
+}
+
+/* mark where the objects bumped out of the current run start, and leave
+ * the rest of it for the next sweep */
+static void leaveRun(void)
+{char *h;
+ for (h = run; h < tiger_avail; h += SIZE(h))
+   setStart(h, 1);
+ stats.allocated += tiger_avail - run;
+ if (tiger_avail < tiger_limit) {
+   HEADER(tiger_avail) = 2 * (tiger_limit - tiger_avail) | FREE;
+   setStart(tiger_avail, 1);
+ }
+ run = tiger_avail = tiger_limit = NULL;
+}
+
+static int nextRun(unsigned n)
+{
+ leaveRun();
+ while (runs) {
+   char *r = runs;
+   runs = *(char **)(r + 4);
+   if (SIZE(r) >= n) {
+     run = tiger_avail = r;
+     tiger_limit = r + SIZE(r);
+     return 1;
+   }
+ }
+ return 0;
+}
+
+static void collect(void)
+{clock_t start = clock(), pause;
+ leaveRun();
+ stats.live = 0;
+ markAll();
+ runs = NULL;
+ sweep();
+ pause = clock() - start;
+ stats.collections++;
+ stats.pause += pause;
+ if (pause > stats.maxPause) stats.maxPause = pause;
+}
+
+static void *alloc(int bytes, int kind)
+{unsigned n;
+ char *h;
+ if (bytes < 0 || bytes > (1 << 30)) outOfMemory();
+ n = (bytes + 4 + 3) & ~3u;
+ if (n > (unsigned)(tiger_limit - tiger_avail)) {
+   if (!tiger_frame) {
+     // not collected: the rest of the chunk is lost
+     unsigned size = n > CHUNK ? n : CHUNK;
+     stats.allocated += tiger_avail - run;
+     if (!(run = tiger_avail = malloc(size))) outOfMemory();
+     tiger_limit = tiger_avail + size;
+   } else {
+     if (!heapStart) initHeap();
+     if (!nextRun(n)) {
+       collect();
+       if (!nextRun(n)) outOfMemory();
+     }
+   }
+ }
+ h = tiger_avail;
+ tiger_avail += n;
+ HEADER(h) = 2 * n | kind;
+ return h + 4;
+}
+
+/* at exit, if $TIGER_GCSTATS is set */
+static void gcReport(void)
+{
+ fprintf(stderr, "gc: heap %ld KB, %ld collections, %ld KB allocated, %ld KB freed,"
+         " %ld KB live after the last; pauses %ld us in all, %ld us at most\n",
+         (long)(heapEnd - heapStart) >> 10, stats.collections,
+         (stats.allocated + (tiger_avail - run)) >> 10, stats.freed >> 10,
+         stats.live >> 10,
+         (long)(stats.pause * 1000000.0 / CLOCKS_PER_SEC),
+         (long)(stats.maxPause * 1000000.0 / CLOCKS_PER_SEC));
+}
+
+/* The loops over characters and words, each in a portable version and,
+ * on x86, in SSE2 and AVX2 versions; main picks the widest the CPU has.
+ * Copies and clears go to memcpy and memset, which libc already tunes
+ * to the CPU. */
+static int equalScalar(unsigned char *s, unsigned char *t, int n)
+{int i;
+ for(i=0;i<n;i++) if (s[i]!=t[i]) return 0;
+ return 1;
+}
+
+static void fillScalar(int *a, int v, int n)
+{int i;
+ for(i=0;i<n;i++) a[i]=v;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+__attribute__((target("sse2")))
+static int equalSSE2(unsigned char *s, unsigned char *t, int n)
+{int i;
+ for (i = 0; i + 16 <= n; i += 16) {
+   __m128i x = _mm_loadu_si128((__m128i *)(s + i));
+   __m128i y = _mm_loadu_si128((__m128i *)(t + i));
+   if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return 0;
+ }
+ return equalScalar(s + i, t + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int equalAVX2(unsigned char *s, unsigned char *t, int n)
 {int i;
- int *a = (int *)malloc(size*sizeof(int));
- for(i=0;i<size;i++) a[i]=init;
+ for (i = 0; i + 32 <= n; i += 32) {
+   __m256i x = _mm256_loadu_si256((__m256i *)(s + i));
+   __m256i y = _mm256_loadu_si256((__m256i *)(t + i));
+   if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != -1) return 0;
+ }
+ return equalSSE2(s + i, t + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void fillSSE2(int *a, int v, int n)
+{__m128i x = _mm_set1_epi32(v);
+ int i;
+ for (i = 0; i + 4 <= n; i += 4)
+   _mm_storeu_si128((__m128i *)(a + i), x);
+ fillScalar(a + i, v, n - i);
+}
+
+__attribute__((target("avx2")))
+static void fillAVX2(int *a, int v, int n)
+{__m256i x = _mm256_set1_epi32(v);
+ int i;
+ for (i = 0; i + 8 <= n; i += 8)
+   _mm256_storeu_si256((__m256i *)(a + i), x);
+ fillSSE2(a + i, v, n - i);
+}
+#endif
+
+static int (*equalChars)(unsigned char *s, unsigned char *t, int n) = equalScalar;
+static void (*fillWords)(int *a, int v, int n) = fillScalar;
+
+static void pickKernels(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+ __builtin_cpu_init();
+ if (__builtin_cpu_supports("avx2")) {
+   equalChars = equalAVX2;
+   fillWords = fillAVX2;
+ } else if (__builtin_cpu_supports("sse2")) {
+   equalChars = equalSSE2;
+   fillWords = fillSSE2;
+ }
+#endif
+}
+
+int *initArray(int size, int init)
+{int *a;
+ roots[nroots++] = (void *)(long)init;
+ a = (int *)alloc(size*sizeof(int), SCAN);
+ nroots--;
+ fillWords(a, init, size);
  return a;
 }
 
 int *allocRecord(int size)
-{int i;
- int *p, *a;
- p = a = (int *)malloc(size);
- for(i=0;i<size;i+=sizeof(int)) *p++ = 0;
+{int *a = (int *)alloc(size, SCAN);
+ memset(a, 0, size);
  return a;
 }
 
+/* A string is its length and its characters; or, if the length is
+ * negative, a concat not yet carried out: ~length characters, those of
+ * "left" and then those of "right".  The characters are put together the
+ * first time they are needed, and "left" is then the result and "right"
+ * NULL, so a string built up by concats is copied once rather than at
+ * every step.  Literals, chr and getchar give flat strings. */
 struct string {int length; unsigned char chars[1];};
+struct rope {int length; struct string *left, *right;};
 
-int stringEqual(struct string *s, struct string *t)
-{int i;
- if (s==t) return 1;
- if (s->length!=t->length) return 0;
- for(i=0;i<s->length;i++) if (s->chars[i]!=t->chars[i]) return 0;
- return 1;
+#define ROPE 32         /* concats shorter than this are done at once */
+
+static struct string **pending;         /* flat's stack, grown as needed */
+static int maxpending;
+
+int size(struct string *s)
+{ 
+ return s->length >= 0 ? s->length : ~s->length;
 }
 
-void flush()
+static struct string *flat(struct string *s)
+{struct rope *r = (struct rope *)s;
+ struct string *t, *u;
+ unsigned char *p;
+ int n;
+ if (s->length >= 0) return s;
+ if (!r->right) return r->left;
+ roots[nroots++] = s;
+ t = (struct string *)alloc(sizeof(int)+size(s), NOSCAN);
+ nroots--;
+ t->length = size(s);
+ /* left to right, with a stack: a rope is as deep as the concats in it */
+ p = t->chars;
+ n = 0;
+ u = s;
+ for (;;) {
+   r = (struct rope *)u;
+   if (u->length < 0 && r->right) {
+     if (n == maxpending) {
+       maxpending = 2 * maxpending + 64;
+       if (!(pending = realloc(pending, maxpending * sizeof(*pending)))) outOfMemory();
+     }
+     pending[n++] = r->right;
+     u = r->left;
+     continue;
+   }
+   u = flat(u);
+   memcpy(p, u->chars, u->length);
+   p += u->length;
+   if (!n) break;
+   u = pending[--n];
+ }
+ r = (struct rope *)s;
+ r->left = t;
+ r->right = NULL;
+ return t;
+}
+
+int stringEqual(struct string *s, struct string *t)
 {
- fflush(stdout);
+ if (s==t) return 1;
+ if (size(s)!=size(t)) return 0;
+ roots[nroots++] = t;
+ s = flat(s);
+ roots[nroots++] = s;
+ t = flat(t);
+ nroots -= 2;
+ return equalChars(s->chars, t->chars, s->length);
 }
 
 void print(struct string *s)
-{int i; unsigned char *p=s->chars;
- for(i=0;i<s->length;i++,p++) putchar(*p);
-  flush();
+{
+ s = flat(s);
+ put(s->chars, s->length);
 }
 
 void printi(int k)
-{
-	printf("%d", k);
-  flush();
+{unsigned char digits[12], *p = digits + sizeof(digits);
+ unsigned u = k < 0 ? -(unsigned)k : k;
+ do *--p = '0' + u % 10; while (u /= 10);
+ if (k < 0) *--p = '-';
+ put(p, digits + sizeof(digits) - p);
 }
 
 
@@ -57,11 +459,16 @@ int main()
    {consts[i].length=1;
     consts[i].chars[0]=i;
    }
+ pickKernels();
+ lineBuffered = getenv("TIGER_LINEBUF") != NULL;
+ atexit(flush);
+ if (getenv("TIGER_GCSTATS")) atexit(gcReport);
  return tigermain(0 /* static link */);
 }
 
 int ord(struct string *s)
 {
+ s = flat(s);
  if (s->length==0) return -1;
  else return s->chars[0];
 }
@@ -69,40 +476,51 @@ int ord(struct string *s)
 struct string *chr(int i)
 {
  if (i<0 || i>=256) 
-   {printf("chr(%d) out of range\n",i); exit(1);}
+   {flush(); printf("chr(%d) out of range\n",i); exit(1);}
  return consts+i;
 }
 
-int size(struct string *s)
-{ 
- return s->length;
-}
-
 struct string *substring(struct string *s, int first, int n)
 {
+ s = flat(s);
  if (first<0 || first+n>s->length)
-   {printf("substring([%d],%d,%d) out of range\n",s->length,first,n);
+   {flush();
+    printf("substring([%d],%d,%d) out of range\n",s->length,first,n);
     exit(1);}
  if (n==1) return consts+s->chars[first];
- {struct string *t = (struct string *)malloc(sizeof(int)+n);
-  int i;
+ {struct string *t;
+  roots[nroots++] = s;
+  t = (struct string *)alloc(sizeof(int)+n, NOSCAN);
+  nroots--;
   t->length=n;
-  for(i=0;i<n;i++) t->chars[i]=s->chars[first+i];
+  memcpy(t->chars, s->chars+first, n);
   return t;
  }
 }
 
 struct string *concat(struct string *a, struct string *b)
-{
- if (a->length==0) return b;
- else if (b->length==0) return a;
- else {int i, n=a->length+b->length;
-       struct string *t = (struct string *)malloc(sizeof(int)+n);
+{int n=size(a)+size(b);
+ if (size(a)==0) return b;
+ else if (size(b)==0) return a;
+ else if (n>=ROPE) {
+   struct rope *r;
+   roots[nroots++] = a;
+   roots[nroots++] = b;
+   r = (struct rope *)alloc(sizeof(*r), SCAN);
+   nroots -= 2;
+   r->length=~n;
+   r->left=a;
+   r->right=b;
+   return (struct string *)r;
+ }
+ else {struct string *t;
+       roots[nroots++] = a;
+       roots[nroots++] = b;
+       t = (struct string *)alloc(sizeof(int)+n, NOSCAN);
+       nroots -= 2;
        t->length=n;
-       for (i=0;i<a->length;i++)
-	 t->chars[i]=a->chars[i];
-       for(i=0;i<b->length;i++)
-	 t->chars[i+a->length]=b->chars[i];
+       memcpy(t->chars, a->chars, a->length);
+       memcpy(t->chars+a->length, b->chars, b->length);
        return t;
      }
 }
@@ -114,7 +532,9 @@ int not(int i)
 #undef getchar
 
 struct string *__wrap_getchar()
-{int i=getc(stdin);
+{int i;
+ flush();
+ i=getc(stdin);
  if (i==EOF) return &empty;
  else return consts+i;
 }
@@ -13,11 +13,23 @@ My_Temp_LabelStack labelStack = NULL;
 
 /*Lab4: Your implementation of lab4*/
 F_fragList SEM_transProg(A_exp exp){
-    // printf("start transProg\n");
-    S_table venv = E_base_venv();
-    S_table tenv = E_base_tenv();
+    // the base environments are built once and serve every file of a
+    // batch: each program's bindings go in a scope that is popped after
+    static S_table venv = NULL, tenv = NULL;
+    if(venv == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
+        venv = E_base_venv();
+        tenv = E_base_tenv();
+        U_regionSwitch(prev);
+    }
+    Temp_newProgram();
+    Tr_newProgram();
     labelStack = My_Empty_Temp_LabelStack();
+    S_beginScope(venv);
+    S_beginScope(tenv);
     struct expty e = transExp(venv, tenv, exp, Tr_outermost());
+    S_endScope(tenv);
+    S_endScope(venv);
     Tr_procFrag(e.exp, Tr_outermost()); 
     return Tr_getResult();
 }
@@ -34,6 +46,14 @@ struct expty expTy(Tr_exp exp, Ty_ty ty) {
 }
 
 
+// an int, which the collector need not look at; an unresolved name may
+// still be a pointer
+static bool isScalarTy(Ty_ty ty) {
+    while(ty->kind == Ty_loopVar || (ty->kind == Ty_name && ty->u.name.ty != NULL))
+        ty = ty->kind == Ty_loopVar ? ty->u.loopTy : ty->u.name.ty;
+    return ty->kind == Ty_int;
+}
+
 static Ty_ty actual_ty(S_table tenv, Ty_ty ty) {
     switch(ty->kind) {
     case Ty_loopVar:
@@ -380,7 +400,6 @@ struct expty transVar(S_table venv, S_table tenv, A_var v, Tr_level level) {
             if(e_enventry->kind == E_funEntry) {
                 EM_error(v->pos, "var should not be func");
             }
-            printf("---------------------------------transvar:%s\n", S_name(v->u.simple));
             return expTy(Tr_simpleVar(e_enventry->u.var.access, level), e_enventry->u.var.ty);
         }
         case A_fieldVar:
@@ -488,6 +507,8 @@ static void transFuncDec(S_table venv, S_table tenv, A_dec d, Tr_level level) {
             Tr_access access = accessList->head;
             accessList = accessList->tail;
             // Tr_access access = Tr_allocLocal(func->u.func.level, TRUE);
+            if(isScalarTy(e_enventry->u.var.ty))
+                Tr_markScalar(access);
             S_enter(venv, fieldlist->head->name, E_VarEntry(access, e_enventry->u.var.ty)); // add to parameter type list
         }
         
@@ -531,10 +552,9 @@ Tr_exp transDec(S_table venv, S_table tenv, A_dec d, Tr_level level) {
                     EM_error(d->pos, "init should not be nil without type specified");
                 }
             }
-            if(d->u.var.escape == FALSE) {
-                printf("----------------------------------false---------%s\n", S_name(d->u.var.var));
-            }
             Tr_access access = Tr_allocLocal(level, d->u.var.escape);
+            if(isScalarTy(tExpty.ty))
+                Tr_markScalar(access);
             S_enter(venv, d->u.var.var, E_VarEntry(access, tExpty.ty));
             return Tr_initVariable(access, tExpty.exp);
         case A_typeDec: {
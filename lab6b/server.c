@@ -0,0 +1,108 @@
+/*
+ * server.c - A compile server on a Unix domain socket.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "util.h"
+#include "errormsg.h"
+#include "server.h"
+
+static void frame(FILE *conn, string kind, char *text, size_t length)
+{
+ if (length == 0) return;
+ fprintf(conn, "%s %lu\n", kind, (unsigned long)length);
+ fwrite(text, 1, length, conn);
+}
+
+/* Answer the request read from "in" on "conn"; FALSE if it was SHUTDOWN */
+static bool serve(FILE *in, FILE *conn, SV_compiler compile)
+{char *line = NULL, *text = NULL, *errText = NULL, *asmText = NULL;
+ size_t lineSize = 0, errLength = 0, asmLength = 0;
+ unsigned long length;
+ FILE *err, *out;
+ bool ok, more = TRUE;
+ int name;
+ ssize_t n = getline(&line, &lineSize, in);
+
+ if (n <= 0) {
+   free(line);
+   return TRUE;
+ }
+ if (line[n-1] == '\n') line[--n] = '\0';
+
+ err = open_memstream(&errText, &errLength);
+ EM_errorsTo(err);
+ if (strncmp(line, "COMPILE ", 8) == 0)
+   ok = compile(line + 8, NULL, NULL);
+ else if (sscanf(line, "SOURCE %lu %n", &length, &name) == 1 && line[name]) {
+   text = malloc(length ? length : 1);
+   if (!text || fread(text, 1, length, in) != length) {
+     EM_error(0, "short source");
+     ok = FALSE;
+   } else {
+     out = open_memstream(&asmText, &asmLength);
+     ok = compile(line + name, fmemopen(text, length, "r"), out);
+     fclose(out);
+   }
+ }
+ else if (strcmp(line, "SHUTDOWN") == 0) {
+   ok = TRUE;
+   more = FALSE;
+ }
+ else {
+   EM_error(0, "bad request: %s", line);
+   ok = FALSE;
+ }
+ EM_errorsTo(NULL);
+ fclose(err);
+
+ frame(conn, "ASM", asmText, asmLength);
+ frame(conn, "ERR", errText, errLength);
+ fprintf(conn, "EXIT %d\n", ok ? 0 : 1);
+ fflush(conn);
+ free(line); free(text); free(errText); free(asmText);
+ return more;
+}
+
+int SV_serve(string path, SV_compiler compile)
+{struct sockaddr_un addr;
+ int listener = socket(AF_UNIX, SOCK_STREAM, 0), fd;
+ bool more = TRUE;
+
+ memset(&addr, 0, sizeof(addr));
+ addr.sun_family = AF_UNIX;
+ if (strlen(path) >= sizeof(addr.sun_path)) {
+   EM_error(0, "socket path too long: %s", path);
+   return 1;
+ }
+ strcpy(addr.sun_path, path);
+ unlink(path);
+ if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0
+     || listen(listener, 64) < 0) {
+   EM_error(0, "cannot listen on %s", path);
+   return 1;
+ }
+ // a client that goes away must not take the server with it
+ signal(SIGPIPE, SIG_IGN);
+
+ while (more) {
+   FILE *in, *conn;
+   if ((fd = accept(listener, NULL, NULL)) < 0) continue;
+   // separate streams, as one stream cannot switch from reading to writing
+   in = fdopen(fd, "r");
+   conn = fdopen(dup(fd), "w");
+   if (in && conn)
+     more = serve(in, conn, compile);
+   if (in) fclose(in); else close(fd);
+   if (conn) fclose(conn);
+ }
+ close(listener);
+ unlink(path);
+ return 0;
+}
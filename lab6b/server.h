@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+/*
+ * server.h - A compile server on a Unix domain socket, for -fserver.
+ *
+ * The server keeps what every compile shares warm between requests:
+ * symbols, the base environments, the machine registers, the regions
+ * and the back end's threads.  It serves one connection at a time, and
+ * each connection carries one request, a line that is one of
+ *
+ *   COMPILE path\n            compile the file "path" to path.s
+ *   SOURCE length name\n...   compile the "length" bytes that follow,
+ *                             called "name" in error messages
+ *   SHUTDOWN\n                stop serving
+ *
+ * The reply is a series of frames: "ASM n\n" and "ERR n\n", each followed
+ * by n bytes of assembly (SOURCE only) or error messages, and a final
+ * "EXIT status\n" with the exit status a.out would have had.
+ */
+
+/* Compile "name", or the source read from "in" (if not NULL) to "out";
+ * FALSE if it has errors */
+typedef bool (*SV_compiler)(string name, FILE *in, FILE *out);
+
+/* The socket used when none is given: $TIGER_SOCKET, or else the
+ * format filled in with the user id (in socket.c, which tiger-client
+ * links too) */
+#define SV_SOCKET_ENV "TIGER_SOCKET"
+#define SV_SOCKET_FORMAT "/tmp/tiger-%d.sock"
+
+string SV_defaultSocket(void);
+
+/* Serve requests on the socket "path" with "compile" until told to stop;
+ * returns the exit status for main */
+int SV_serve(string path, SV_compiler compile);
+
+#endif
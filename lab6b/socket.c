@@ -0,0 +1,18 @@
+/*
+ * socket.c - The compile server's default socket, shared by a.out and
+ *            tiger-client.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "util.h"
+#include "server.h"
+
+string SV_defaultSocket(void)
+{static char path[64];
+ string env = getenv(SV_SOCKET_ENV);
+ if (env && *env) return env;
+ snprintf(path, sizeof(path), SV_SOCKET_FORMAT, (int)getuid());
+ return path;
+}
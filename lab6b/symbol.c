@@ -1,51 +1,100 @@
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "util.h"
 #include "symbol.h"
 #include "table.h"
 
-struct S_symbol_ {string name; S_symbol next;};
+/* The hash and length are kept so that interning compares them before
+ * ever touching the name bytes. */
+struct S_symbol_ {string name; int length; unsigned hash;};
 
-static S_symbol mksymbol(string name, S_symbol next)
-{S_symbol s=checked_malloc(sizeof(*s));
- s->name=name; 
- s->next=next;
+/* Symbols live as long as the compiler does, so they and their names go
+ * into the permanent region.  Names are packed end to end in a string
+ * pool instead of getting an allocation each. */
+#define POOLSIZE 16384
+
+static char *poolAvail = NULL, *poolLimit = NULL;
+
+static string poolString(string name, int length)
+{string p;
+ if (length + 1 > POOLSIZE/4)
+   p = U_regionAlloc(U_permanent(), length + 1);
+ else {
+   if (length + 1 > poolLimit - poolAvail) {
+     poolAvail = U_regionAlloc(U_permanent(), POOLSIZE);
+     poolLimit = poolAvail + POOLSIZE;
+   }
+   p = poolAvail;
+   poolAvail += length + 1;
+ }
+ memcpy(p, name, length);
+ p[length] = '\0';
+ return p;
+}
+
+static S_symbol mksymbol(string name, int length, unsigned h)
+{S_symbol s = U_regionAlloc(U_permanent(), sizeof(*s));
+ s->name = poolString(name, length);
+ s->length = length;
+ s->hash = h;
  return s;
 }
 
-#define SIZE 109  /* should be prime */
+/* Open addressing with linear probing; doubles when half full.  Back
+ * ends running in parallel make labels, so interning takes a lock. */
+#define INITSIZE 1024  /* must be a power of 2 */
 
-static S_symbol hashtable[SIZE];
+static S_symbol *hashtable = NULL;
+static unsigned tableSize = 0, symbols = 0;
+static pthread_mutex_t symbolLock = PTHREAD_MUTEX_INITIALIZER;
 
-static unsigned int hash(char *s0)
+static unsigned int hash(char *s0, int *length)
 {unsigned int h=0; char *s;
- for(s=s0; *s; s++)  
+ for(s=s0; *s; s++)
        h = h*65599 + *s;
+ *length = s - s0;
  return h;
 }
- 
-static int streq(string a, string b)
-{
- return !strcmp(a,b);
+
+static void grow(void)
+{S_symbol *old = hashtable;
+ unsigned i, j, oldSize = tableSize;
+ tableSize = tableSize ? 2 * tableSize : INITSIZE;
+ hashtable = U_regionAlloc(U_permanent(), tableSize * sizeof(S_symbol));
+ memset(hashtable, 0, tableSize * sizeof(S_symbol));
+ for (i = 0; i < oldSize; i++)
+   if (old[i]) {
+     for (j = old[i]->hash & (tableSize-1); hashtable[j]; j = (j+1) & (tableSize-1)) ;
+     hashtable[j] = old[i];
+   }
 }
 
 S_symbol S_Symbol(string name)
-{int index= hash(name) % SIZE;
- S_symbol syms = hashtable[index], sym;
- for(sym=syms; sym; sym=sym->next)
-   if (streq(sym->name,name)) return sym;
- sym = mksymbol(name,syms);
- hashtable[index]=sym;
+{int length;
+ unsigned h = hash(name, &length), index;
+ S_symbol sym;
+ pthread_mutex_lock(&symbolLock);
+ if (2 * (symbols + 1) > tableSize) grow();
+ for (index = h & (tableSize-1); (sym = hashtable[index]); index = (index+1) & (tableSize-1))
+   if (sym->hash == h && sym->length == length && !memcmp(sym->name, name, length))
+     break;
+ if (!sym) {
+   sym = mksymbol(name, length, h);
+   hashtable[index] = sym;
+   symbols++;
+ }
+ pthread_mutex_unlock(&symbolLock);
  return sym;
 }
- 
+
 string S_name(S_symbol sym)
 {
  return sym->name;
 }
 
-S_table S_empty(void) 
-{ 
+S_table S_empty(void)
+{
  return TAB_empty();
 }
 
@@ -57,7 +106,7 @@ void *S_look(S_table t, S_symbol sym) {
   return TAB_look(t,sym);
 }
 
-static struct S_symbol_ marksym = {"<mark>",0};
+static struct S_symbol_ marksym = {"<mark>",6,0};
 
 void S_beginScope(S_table t)
 { S_enter(t,&marksym,NULL);
@@ -9,7 +9,8 @@ typedef struct S_symbol_ *S_symbol;
 
 /* Make a unique symbol from a given string.  
  *  Different calls to S_Symbol("foo") will yield the same S_symbol
- *  value, even if the "foo" strings are at different locations. */
+ *  value, even if the "foo" strings are at different locations.
+ *  The name is copied, so the caller may reuse its buffer. */
 S_symbol S_Symbol(string);
 
 /* Extract the underlying string from a symbol */
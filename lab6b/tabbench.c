@@ -0,0 +1,93 @@
+/*
+ * tabbench.c - Compare TAB_table against the old fixed 127-bucket
+ *              chained table on pointer keys, the way liveness.c and
+ *              color.c use it (enter every key, then look each one up).
+ *
+ *              make tabbench && ./tabbench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "util.h"
+#include "table.h"
+
+/* the table.c this one replaced */
+#define TABSIZE 127
+
+typedef struct oldBinder_ *oldBinder;
+struct oldBinder_ {void *key; void *value; oldBinder next; void *prevtop;};
+typedef struct oldTable_ {oldBinder table[TABSIZE]; void *top;} *oldTable;
+
+static oldTable old_empty(void)
+{oldTable t = checked_malloc(sizeof(*t));
+ int i;
+ t->top = NULL;
+ for (i = 0; i < TABSIZE; i++) t->table[i] = NULL;
+ return t;
+}
+
+static void old_enter(oldTable t, void *key, void *value)
+{int index = ((unsigned long)key) % TABSIZE;
+ oldBinder b = checked_malloc(sizeof(*b));
+ b->key = key; b->value = value; b->next = t->table[index]; b->prevtop = t->top;
+ t->table[index] = b;
+ t->top = key;
+}
+
+static void *old_look(oldTable t, void *key)
+{int index = ((unsigned long)key) % TABSIZE;
+ oldBinder b;
+ for (b = t->table[index]; b; b = b->next)
+   if (b->key == key) return b->value;
+ return NULL;
+}
+
+
+static double seconds(clock_t start)
+{
+ return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench(int n)
+{void **keys = checked_malloc(n * sizeof(void *));
+ U_region r = U_Region("bench");
+ U_region prev = U_regionSwitch(r);
+ clock_t start;
+ double told, tnew;
+ long found = 0;
+ int i, rounds = 5, k;
+
+ /* keys shaped like Temp_temps: small objects from one allocator */
+ for (i = 0; i < n; i++) keys[i] = checked_malloc(16);
+
+ start = clock();
+ for (k = 0; k < rounds; k++) {
+   oldTable t = old_empty();
+   for (i = 0; i < n; i++) old_enter(t, keys[i], keys[i]);
+   for (i = 0; i < n; i++) found += old_look(t, keys[i]) == keys[i];
+ }
+ told = seconds(start);
+
+ start = clock();
+ for (k = 0; k < rounds; k++) {
+   TAB_table t = TAB_empty();
+   for (i = 0; i < n; i++) TAB_enter(t, keys[i], keys[i]);
+   for (i = 0; i < n; i++) found += TAB_look(t, keys[i]) == keys[i];
+ }
+ tnew = seconds(start);
+
+ assert(found == 2L * rounds * n);
+ printf("%8d keys   old %9.4fs   new %9.4fs   speedup %7.1fx\n",
+        n, told, tnew, tnew > 0 ? told / tnew : 0.0);
+ U_regionSwitch(prev);
+ U_regionReset(r);
+}
+
+int main(void)
+{
+ bench(1000);
+ bench(10000);
+ bench(100000);
+ return 0;
+}
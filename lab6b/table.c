@@ -1,88 +1,141 @@
 /*
  * table.c - Functions to manipulate generic tables.
  * Copyright (c) 1997 Andrew W. Appel.
+ *
+ * The bindings form a stack (so TAB_pop and TAB_dump see them in order of
+ * entry), and an open-addressing hash index maps each key to its most
+ * recent binding.  A binding remembers the one it shadows, so popping it
+ * exposes the older binding again.  Both arrays double as they fill.
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "util.h"
 #include "table.h"
 
-#define TABSIZE 127
+#define INITSIZE 16   /* hash slots; must be a power of 2 */
 
 typedef struct binder_ *binder;
-struct binder_ {void *key; void *value; binder next; void *prevtop;};
+struct binder_ {void *key; void *value; int shadowed;};
+
+struct slot_ {void *key; int binding;};
+
 struct TAB_table_ {
-  binder table[TABSIZE];
-  void *top;
+  struct slot_ *slots;     /* capacity is 1 << bits */
+  int bits, nkeys;
+  binder stack;            /* stack[0..top-1] are the live bindings */
+  int top, max;
+  U_region region;         /* where the arrays are (re)allocated */
 };
 
 
-static binder Binder(void *key, void *value, binder next, void *prevtop)
-{binder b = checked_malloc(sizeof(*b));
- b->key = key; b->value=value; b->next=next; b->prevtop = prevtop; 
- return b;
+/* Fibonacci hashing: pointer keys are aligned, so their low bits carry
+ * nothing; multiplying spreads every bit into the top "bits" bits. */
+static unsigned hash(void *key, int bits)
+{
+ return (unsigned)(((unsigned long long)(unsigned long)key
+                    * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static struct slot_ *Slots(TAB_table t, int bits)
+{struct slot_ *s = U_regionAlloc(t->region, sizeof(*s) << bits);
+ memset(s, 0, sizeof(*s) << bits);
+ return s;
 }
 
 TAB_table TAB_empty(void)
-{ 
+{
  TAB_table t = checked_malloc(sizeof(*t));
- int i;
- t->top = NULL;
- for (i = 0; i < TABSIZE; i++)
-   t->table[i] = NULL;
+ t->region = U_regionSwitch(NULL);
+ t->bits = 0;
+ while ((1 << t->bits) < INITSIZE) t->bits++;
+ t->slots = Slots(t, t->bits);
+ t->nkeys = 0;
+ t->max = INITSIZE/2;
+ t->stack = U_regionAlloc(t->region, t->max * sizeof(*t->stack));
+ t->top = 0;
  return t;
 }
 
-/* The cast from pointer to integer in the expression
- *   ((unsigned)key) % TABSIZE
- * may lead to a warning message.  However, the code is safe,
- * and will still operate correctly.  This line is just hashing
- * a pointer value into an integer value, and no matter how the
- * conversion is done, as long as it is done consistently, a
- * reasonable and repeatable index into the table will result.
- */
+/* index of the slot holding "key", or of the empty slot where it belongs */
+static unsigned find(TAB_table t, void *key)
+{unsigned mask = (1u << t->bits) - 1, i = hash(key, t->bits);
+ while (t->slots[i].key && t->slots[i].key != key)
+   i = (i + 1) & mask;
+ return i;
+}
+
+static void grow(TAB_table t)
+{struct slot_ *old = t->slots;
+ int i, n = 1 << t->bits;
+ t->slots = Slots(t, ++t->bits);
+ for (i = 0; i < n; i++)
+   if (old[i].key) t->slots[find(t, old[i].key)] = old[i];
+}
+
+/* Empty slot i, then shift later members of its probe run back into the
+ * hole so that lookups never stop short (no tombstones needed). */
+static void delete(TAB_table t, unsigned i)
+{unsigned mask = (1u << t->bits) - 1, j = i, home;
+ for (;;) {
+   t->slots[i].key = NULL;
+   do {
+     j = (j + 1) & mask;
+     if (!t->slots[j].key) return;
+     home = hash(t->slots[j].key, t->bits);
+   } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+   t->slots[i] = t->slots[j];
+   i = j;
+ }
+}
 
 void TAB_enter(TAB_table t, void *key, void *value)
-{int index;
+{unsigned i;
+ binder b;
  assert(t && key);
- index = ((unsigned long )key) % TABSIZE;
- t->table[index] = Binder(key, value,t->table[index], t->top);
- t->top = key;
+ if (t->top == t->max) {
+   binder old = t->stack;
+   t->max *= 2;
+   t->stack = U_regionAlloc(t->region, t->max * sizeof(*t->stack));
+   memcpy(t->stack, old, t->top * sizeof(*t->stack));
+ }
+ if (2 * (t->nkeys + 1) > (1 << t->bits)) grow(t);
+ i = find(t, key);
+ b = &t->stack[t->top];
+ b->key = key; b->value = value;
+ if (t->slots[i].key) b->shadowed = t->slots[i].binding;
+ else {
+   b->shadowed = -1;
+   t->slots[i].key = key;
+   t->nkeys++;
+ }
+ t->slots[i].binding = t->top++;
 }
 
 void *TAB_look(TAB_table t, void *key)
-{int index;
- binder b;
+{unsigned i;
  assert(t && key);
- index=((unsigned long)key) % TABSIZE;
- for(b=t->table[index]; b; b=b->next)
-   if (b->key==key) return b->value;
- return NULL;
+ i = find(t, key);
+ if (!t->slots[i].key) return NULL;
+ return t->stack[t->slots[i].binding].value;
 }
 
 void *TAB_pop(TAB_table t) {
-  void *k; binder b; int index;
-  assert (t);
-  k = t->top;
-  assert (k);
-  index = ((unsigned long)k) % TABSIZE;
-  b = t->table[index];
-  assert(b);
-  t->table[index] = b->next;
-  t->top=b->prevtop;
+  binder b; unsigned i;
+  assert (t && t->top > 0);
+  b = &t->stack[--t->top];
+  i = find(t, b->key);
+  assert(t->slots[i].key == b->key && t->slots[i].binding == t->top);
+  if (b->shadowed >= 0) t->slots[i].binding = b->shadowed;
+  else {
+    delete(t, i);
+    t->nkeys--;
+  }
   return b->key;
 }
 
 void TAB_dump(TAB_table t, void (*show)(void *key, void *value)) {
-  void *k = t->top;
-  int index = ((unsigned long)k) % TABSIZE;
-  binder b = t->table[index];
-  if (b==NULL) return;
-  t->table[index]=b->next;
-  t->top=b->prevtop;
-  show(b->key,b->value);
-  TAB_dump(t,show);
-  assert(t->top == b->prevtop && t->table[index]==b->next);
-  t->top=k;
-  t->table[index]=b;
+  int i;
+  for (i = t->top - 1; i >= 0; i--)
+    show(t->stack[i].key, t->stack[i].value);
 }
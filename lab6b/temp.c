@@ -11,7 +11,6 @@
 #include "util.h"
 #include "symbol.h"
 #include "temp.h"
-#include "table.h"
 
 struct Temp_temp_ {int num;};
 
@@ -25,10 +24,18 @@ string Temp_labelstring(Temp_label s)
 
 static int labels = 0;
 
+/* the function set by Temp_function, and its own numbering */
+static __thread string function = NULL;
+static __thread int functionLabels, functionTemps;
+static __thread Temp_map functionNames = NULL;
+
 Temp_label Temp_newlabel(void)
 {char buf[100];
- sprintf(buf,"L%d",labels++);
- return Temp_namedlabel(String(buf));
+ if (function)
+   sprintf(buf,"%.80s.L%d",function,functionLabels++);
+ else
+   sprintf(buf,"L%d",labels++);
+ return Temp_namedlabel(buf);
 }
 
 /* The label will be created only if it is not found. */
@@ -38,28 +45,72 @@ Temp_label Temp_namedlabel(string s)
 
 static int temps = 100;
 
+/* the program set by Temp_newProgram: its temps are numbered from
+ * programBase, and named in programNames */
+static bool program = FALSE;
+static int programBase;
+static Temp_map programNames = NULL;
+
+/* Temps made before the first program (the machine registers) and their
+ * Temp_name() entries live as long as the compiler.  A program's temps
+ * live in the current region, a function's as long as its back end. */
 Temp_temp Temp_newtemp(void)
-{Temp_temp p = (Temp_temp) checked_malloc(sizeof (*p));
- p->num=temps++;
+{U_region prev = function || program ? NULL : U_regionSwitch(U_permanent());
+ Temp_temp p = (Temp_temp) checked_malloc(sizeof (*p));
+ p->num = function ? functionTemps++ : temps++;
  {char r[16];
   sprintf(r, "%d", p->num);
   Temp_enter(Temp_name(), p, String(r));
  }
+ if (prev) U_regionSwitch(prev);
  return p;
 }
 
 
 
-struct Temp_map_ {TAB_table tab; Temp_map under;};
+/* A Temp_map layer is a flat array of names indexed by temp number,
+ * covering temps lo..hi-1; it grows (in the region it was made in) to
+ * take in any temp entered.  Temp_layerMap shares the arrays of "over",
+ * so a lookup costs one index per layer of the fallback chain. */
+typedef struct Temp_names_ *Temp_names;
+struct Temp_names_ {string *names; int lo, hi; U_region region;};
+struct Temp_map_ {Temp_names tab; Temp_map under;};
 
 
-Temp_map Temp_name(void) {
+static Temp_map permanentNames(void) {
  static Temp_map m = NULL;
- if (!m) m=Temp_empty();
+ if (!m) {
+   U_region prev = U_regionSwitch(U_permanent());
+   m=Temp_empty();
+   U_regionSwitch(prev);
+ }
  return m;
 }
 
-Temp_map newMap(TAB_table tab, Temp_map under) {
+Temp_map Temp_name(void) {
+ return function ? functionNames : program ? programNames : permanentNames();
+}
+
+void Temp_newProgram(void) {
+ if (!program) {
+   program = TRUE;
+   programBase = temps;
+ }
+ labels = 0;
+ temps = programBase;
+ programNames = Temp_layerMap(Temp_empty(), permanentNames());
+}
+
+void Temp_function(string name) {
+ function = name;
+ if (!name) return;
+ functionLabels = 0;
+ functionTemps = temps;
+ functionNames = Temp_layerMap(Temp_empty(),
+                               program ? programNames : permanentNames());
+}
+
+static Temp_map newMap(Temp_names tab, Temp_map under) {
   Temp_map m = checked_malloc(sizeof(*m));
   m->tab=tab;
   m->under=under;
@@ -67,7 +118,11 @@ Temp_map newMap(TAB_table tab, Temp_map under) {
 }
 
 Temp_map Temp_empty(void) {
-  return newMap(TAB_empty(), NULL);
+  Temp_names tab = checked_malloc(sizeof(*tab));
+  tab->names = NULL;
+  tab->lo = tab->hi = 0;
+  tab->region = U_regionSwitch(NULL);
+  return newMap(tab, NULL);
 }
 
 Temp_map Temp_layerMap(Temp_map over, Temp_map under) {
@@ -76,18 +131,44 @@ Temp_map Temp_layerMap(Temp_map over, Temp_map under) {
   else return newMap(over->tab, Temp_layerMap(over->under, under));
 }
 
+/* widen tab to cover temp number n, at least doubling it */
+static void growNames(Temp_names tab, int n) {
+  int size = tab->hi - tab->lo, lo, hi;
+  string *names;
+  if (size == 0) {
+    lo = n; hi = n + 16;
+  } else if (n >= tab->hi) {
+    lo = tab->lo;
+    hi = lo + (n + 1 - lo > 2 * size ? n + 1 - lo : 2 * size);
+  } else {
+    hi = tab->hi;
+    lo = hi - (hi - n > 2 * size ? hi - n : 2 * size);
+    if (lo < 0) lo = 0;
+  }
+  names = U_regionAlloc(tab->region, (hi - lo) * sizeof(string));
+  memset(names, 0, (hi - lo) * sizeof(string));
+  if (size)
+    memcpy(names + (tab->lo - lo), tab->names, size * sizeof(string));
+  tab->names = names;
+  tab->lo = lo;
+  tab->hi = hi;
+}
+
 void Temp_enter(Temp_map m, Temp_temp t, string s) {
   assert(m && m->tab);
-  TAB_enter(m->tab,t,s);
+  if (t->num < m->tab->lo || t->num >= m->tab->hi)
+    growNames(m->tab, t->num);
+  m->tab->names[t->num - m->tab->lo] = s;
 }
 
 string Temp_look(Temp_map m, Temp_temp t) {
-  string s;
-  assert(m && m->tab);
-  s = TAB_look(m->tab, t);
-  if (s) return s;
-  else if (m->under) return Temp_look(m->under, t);
-  else return NULL;
+  int n = t->num;
+  for (; m; m = m->under) {
+    Temp_names tab = m->tab;
+    if (n >= tab->lo && n < tab->hi && tab->names[n - tab->lo])
+      return tab->names[n - tab->lo];
+  }
+  return NULL;
 }
 
 Temp_tempList Temp_TempList(Temp_temp h, Temp_tempList t) 
@@ -102,14 +183,11 @@ Temp_labelList Temp_LabelList(Temp_label h, Temp_labelList t)
  return p;
 }
 
-static FILE *outfile;
-void showit(Temp_temp t, string r) {
-  fprintf(outfile, "t%d -> %s\n", t->num, r);
-}
-
 void Temp_dumpMap(FILE *out, Temp_map m) {
-  outfile=out;
-  TAB_dump(m->tab,(void (*)(void *, void*))showit);
+  int n;
+  for (n = m->tab->hi - 1; n >= m->tab->lo; n--)
+    if (m->tab->names[n - m->tab->lo])
+      fprintf(out, "t%d -> %s\n", n, m->tab->names[n - m->tab->lo]);
   if (m->under) {
      fprintf(out,"---------\n");
      Temp_dumpMap(out,m->under);
@@ -56,6 +56,21 @@ void Temp_dumpMap(FILE *out, Temp_map m);
 
 Temp_map Temp_name(void);
 
+/* Start on a new program: labels count from L0 again, and temps from
+ * where the ones made before the first program (the machine registers)
+ * stopped.  The program's temps and names live in the current region,
+ * so a long-running compiler does not keep every program's temps, and a
+ * file compiles the same alone, in a batch or in the server. */
+void Temp_newProgram(void);
+
+/* Number the temps and labels this thread makes from now on privately to
+ * the function "name", so back ends can run in any order and in parallel
+ * yet name things the same way: temps count up from where the front end
+ * stopped, labels are "name.Ln", and Temp_name() covers the function's
+ * own temps over the program's.  Call only after the front end;
+ * Temp_function(NULL) goes back to the front end's numbering. */
+void Temp_function(string name);
+
 
 typedef struct My_Temp_LabelStack_ *My_Temp_LabelStack;
 struct My_Temp_LabelStack_ {
@@ -0,0 +1,177 @@
+/*
+ * timevar.c - Per-phase compile statistics.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "util.h"
+#include "timevar.h"
+
+static const char *phaseNames[TV_PHASES] = {
+    "parse", "escape", "semant",
+    "linearize", "basic blocks", "trace schedule", "cache", "codegen",
+    "flowgraph", "liveness", "color", "linear scan", "rewrite",
+    "emit"
+};
+
+struct stat {
+    long calls;
+    double wall, cpu;          /* seconds */
+    size_t alloc;              /* bytes */
+    long nodes;
+};
+
+struct unit {
+    string name;
+    int order;
+    struct stat phases[TV_PHASES];
+};
+
+/* Every thread charges its own current unit; only the list of all units
+ * is shared. */
+static bool enabled = FALSE;
+static struct unit **units = NULL;
+static int nunits = 0, maxunits = 0;
+static pthread_mutex_t unitLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct unit *unit = NULL;
+
+/* start of the phase being timed */
+static __thread double startWall, startCpu;
+static __thread size_t startAlloc;
+
+static double now(clockid_t clock)
+{struct timespec ts;
+ clock_gettime(clock, &ts);
+ return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void TV_enable(void)
+{
+ enabled = TRUE;
+}
+
+/* Units outlive the regions that the back end resets, so they are kept
+ * in the permanent one. */
+void TV_unit(string name, int order)
+{struct unit *u;
+ if (!enabled) return;
+ u = U_regionAlloc(U_permanent(), sizeof(*u));
+ memset(u, 0, sizeof(*u));
+ u->name = name;
+ u->order = order;
+ pthread_mutex_lock(&unitLock);
+ if (nunits == maxunits) {
+   struct unit **old = units;
+   maxunits = maxunits ? 2 * maxunits : 16;
+   units = U_regionAlloc(U_permanent(), maxunits * sizeof(*units));
+   if (nunits) memcpy(units, old, nunits * sizeof(*units));
+ }
+ units[nunits++] = u;
+ pthread_mutex_unlock(&unitLock);
+ unit = u;
+}
+
+void TV_start(TV_phase p)
+{
+ if (!enabled) return;
+ if (!unit) TV_unit("<program>", -1);
+ startWall = now(CLOCK_MONOTONIC);
+ startCpu = now(CLOCK_THREAD_CPUTIME_ID);
+ startAlloc = U_allocated();
+}
+
+void TV_stop(TV_phase p, int nodes)
+{struct stat *s;
+ if (!enabled) return;
+ s = &unit->phases[p];
+ s->calls++;
+ s->wall += now(CLOCK_MONOTONIC) - startWall;
+ s->cpu += now(CLOCK_THREAD_CPUTIME_ID) - startCpu;
+ s->alloc += U_allocated() - startAlloc;
+ s->nodes += nodes;
+}
+
+static void addStat(struct stat *to, struct stat *s)
+{
+ to->calls += s->calls;
+ to->wall += s->wall;
+ to->cpu += s->cpu;
+ to->alloc += s->alloc;
+ to->nodes += s->nodes;
+}
+
+static void printTable(FILE *out, struct unit *u)
+{int p;
+ fprintf(out, "%s\n", u->name);
+ for (p = 0; p < TV_PHASES; p++) {
+   struct stat *s = &u->phases[p];
+   if (s->calls == 0) continue;
+   fprintf(out, "  %-16s %6ld %10.3f %10.3f %12.1f %10ld\n", phaseNames[p],
+           s->calls, s->wall * 1e3, s->cpu * 1e3, s->alloc / 1024.0, s->nodes);
+ }
+}
+
+static void printJsonString(FILE *out, string str)
+{
+ fputc('"', out);
+ for (; *str; str++) {
+   if (*str == '"' || *str == '\\') fputc('\\', out);
+   if ((unsigned char)*str < ' ') fprintf(out, "\\u%04x", *str);
+   else fputc(*str, out);
+ }
+ fputc('"', out);
+}
+
+static void printJson(FILE *out, struct unit *u)
+{int p;
+ bool first = TRUE;
+ fprintf(out, "{\"name\": ");
+ printJsonString(out, u->name);
+ fprintf(out, ", \"phases\": {");
+ for (p = 0; p < TV_PHASES; p++) {
+   struct stat *s = &u->phases[p];
+   if (s->calls == 0) continue;
+   fprintf(out, "%s\n    \"%s\": {\"calls\": %ld, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+           "\"alloc_bytes\": %lu, \"nodes\": %ld}", first ? "" : ",", phaseNames[p],
+           s->calls, s->wall * 1e3, s->cpu * 1e3, (unsigned long)s->alloc, s->nodes);
+   first = FALSE;
+ }
+ fprintf(out, "}}");
+}
+
+static int compareOrder(const void *a, const void *b)
+{
+ return (*(struct unit **)a)->order - (*(struct unit **)b)->order;
+}
+
+void TV_report(FILE *out, bool json)
+{struct unit total;
+ int i, p;
+ if (!enabled) return;
+ qsort(units, nunits, sizeof(*units), compareOrder);
+ memset(&total, 0, sizeof(total));
+ total.name = "TOTAL";
+ for (i = 0; i < nunits; i++)
+   for (p = 0; p < TV_PHASES; p++)
+     addStat(&total.phases[p], &units[i]->phases[p]);
+
+ if (json) {
+   fprintf(out, "{\"units\": [");
+   for (i = 0; i < nunits; i++) {
+     fprintf(out, "%s\n  ", i ? "," : "");
+     printJson(out, units[i]);
+   }
+   fprintf(out, "],\n\"total\": ");
+   printJson(out, &total);
+   fprintf(out, "}\n");
+   return;
+ }
+ fprintf(out, "%-18s %6s %10s %10s %12s %10s\n",
+         "unit / phase", "calls", "wall ms", "cpu ms", "alloc KB", "nodes");
+ for (i = 0; i < nunits; i++)
+   printTable(out, units[i]);
+ printTable(out, &total);
+}
@@ -0,0 +1,36 @@
+#ifndef TIMEVAR_H
+#define TIMEVAR_H
+/*
+ * timevar.h - Per-phase compile statistics, for -ftime-report.
+ *
+ * A phase is bracketed by TV_start and TV_stop, which charge the wall and
+ * CPU time and the bytes allocated in between to the thread's current
+ * unit: the front end, or the function fragment being compiled.  Until
+ * TV_enable is called they do nothing.
+ */
+
+typedef enum {
+    TV_PARSE, TV_ESCAPE, TV_SEMANT,
+    TV_LINEARIZE, TV_BASIC_BLOCKS, TV_TRACE, TV_CACHE, TV_CODEGEN,
+    TV_FLOWGRAPH, TV_LIVENESS, TV_COLOR, TV_LINEAR_SCAN, TV_REWRITE,
+    TV_EMIT,
+    TV_PHASES
+} TV_phase;
+
+/* Start collecting */
+void TV_enable(void);
+
+/* Charge the phases this thread runs next to a new unit called "name";
+ * the report lists units by "order" */
+void TV_unit(string name, int order);
+
+/* Time one run of phase "p"; "nodes" counts what it produced (statements,
+ * blocks, cache hits, instructions, graph nodes or spills, depending on
+ * the phase) */
+void TV_start(TV_phase p);
+void TV_stop(TV_phase p, int nodes);
+
+/* Print every unit and the totals, as a table or as JSON */
+void TV_report(FILE *out, bool json);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * trace.c - Back end debug output by channel.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "trace.h"
+
+static const char *channelNames[TR_CHANNELS] = {
+    "flowgraph", "liveness", "coloring", "spill"
+};
+
+__thread unsigned TR_active = 0;
+FILE *TR_out = NULL;
+
+/* channels asked for, and the functions they are limited to (if any) */
+static unsigned enabled = 0;
+
+typedef struct nameList_ *nameList;
+struct nameList_ {string head; nameList tail;};
+static nameList only = NULL;
+
+bool TR_enable(string channels)
+{string p = channels;
+ // set here, before any back end thread can look at it
+ if (!TR_out) TR_out = stderr;
+ while (*p) {
+   int c, len = strcspn(p, ",");
+   if (len == 3 && !strncmp(p, "all", 3))
+     enabled = (1u << TR_CHANNELS) - 1;
+   else {
+     for (c = 0; c < TR_CHANNELS; c++)
+       if (strlen(channelNames[c]) == len && !strncmp(p, channelNames[c], len))
+         break;
+     if (c == TR_CHANNELS) return FALSE;
+     enabled |= 1u << c;
+   }
+   p += len;
+   if (*p) p++;
+ }
+ return TRUE;
+}
+
+/* The list outlives the regions the back end resets. */
+void TR_onlyFunction(string name)
+{nameList l = U_regionAlloc(U_permanent(), sizeof(*l));
+ l->head = name;
+ l->tail = only;
+ only = l;
+}
+
+bool TR_file(string name)
+{FILE *f = fopen(name, "w");
+ if (!f) return FALSE;
+ TR_out = f;
+ return TRUE;
+}
+
+void TR_function(string name)
+{nameList l;
+ TR_active = 0;
+ if (!enabled) return;
+ if (!only) {
+   TR_active = enabled;
+   return;
+ }
+ for (l = only; l; l = l->tail)
+   if (!strcmp(l->head, name)) {
+     TR_active = enabled;
+     return;
+   }
+}
@@ -0,0 +1,42 @@
+#ifndef TRACE_H
+#define TRACE_H
+/*
+ * trace.h - Back end debug output by channel, for -ftrace.
+ *
+ * Channels are switched on from the command line, either for every
+ * function or only for those named with -ftrace-function.  While a
+ * channel is off, TR_printf is one test of a global mask and its
+ * arguments are not evaluated.  Functions compiled in parallel trace
+ * at the same time, so use -j1 to keep each function's lines together.
+ */
+
+typedef enum {
+    TR_FLOWGRAPH, TR_LIVENESS, TR_COLORING, TR_SPILL,
+    TR_CHANNELS
+} TR_channel;
+
+/* The channels on for the function this thread is compiling, one bit each */
+extern __thread unsigned TR_active;
+
+/* Where traces go: stderr unless TR_file was called */
+extern FILE *TR_out;
+
+#define TR_on(c) (TR_active & (1u << (c)))
+
+#define TR_printf(c, ...) \
+    do { if (TR_on(c)) fprintf(TR_out, __VA_ARGS__); } while (0)
+
+/* Turn on a comma-separated list of channels ("all" for every one);
+ * FALSE if a name is not a channel */
+bool TR_enable(string channels);
+
+/* Trace only the function called "name"; may be given several times */
+void TR_onlyFunction(string name);
+
+/* Send traces to the file "name"; FALSE if it cannot be opened */
+bool TR_file(string name);
+
+/* The function "name" is about to be compiled: set TR_active for it */
+void TR_function(string name);
+
+#endif
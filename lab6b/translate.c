@@ -10,6 +10,7 @@
 #include "translate.h"
 
 static F_fragList fragList = NULL;
+static Tr_level outermost = NULL;
 
 typedef struct patchList_ *patchList;
 struct patchList_ {
@@ -61,14 +62,23 @@ patchList joinPatch(patchList first, patchList second) {
 
 
 Tr_level Tr_outermost() {
-    static Tr_level p = NULL;
-    if(p == NULL) {
-        p = checked_malloc(sizeof(*p));
-        p->levelIndex = 0;
-        p->frame = F_newFrame(Temp_namedlabel("tigermain"), NULL);
-        p->accessList = NULL; 
+    if(outermost == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
+        outermost = checked_malloc(sizeof(*outermost));
+        outermost->levelIndex = 0;
+        outermost->parent = NULL;
+        outermost->frame = NULL;
+        outermost->accessList = NULL;
+        U_regionSwitch(prev);
     }
-    return p;
+    return outermost;
+}
+
+void Tr_newProgram(void) {
+    Tr_level p = Tr_outermost();
+    p->frame = F_newFrame(Temp_namedlabel("tigermain"), NULL);
+    p->accessList = NULL;
+    fragList = NULL;
 }
 
 Tr_level Tr_newLevel(Tr_level parent, Temp_label name, U_boolList formals) {
@@ -91,6 +101,7 @@ Tr_level Tr_newLevel(Tr_level parent, Temp_label name, U_boolList formals) {
         // p->accessList = Tr_AccessList(Tr_Access(p, tList->head), p->accessList);
     }
     p->accessList = accessListHead;
+    Tr_markScalar(accessListHead->head);    // the static link is a frame pointer
     return p;
 }
 
@@ -109,6 +120,10 @@ Tr_access Tr_allocLocal(Tr_level level, bool escape) {
     return access;
 }
 
+void Tr_markScalar(Tr_access access) {
+    F_markScalar(access->level->frame, access->access);
+}
+
 static Tr_access Tr_Access(Tr_level level, F_access access) {
     Tr_access p = checked_malloc(sizeof(*p));
     p->level = level;
@@ -219,7 +234,6 @@ static struct Cx unCx(Tr_exp e) {
 
 
 Tr_exp Tr_simpleVar(Tr_access access, Tr_level currentLevel) {
-    printf("-------------- - accesslevel:%d , currentLevel:%d\n", access->level->levelIndex, currentLevel->levelIndex);
     Tr_level targetLevel = access->level;
     T_exp current = T_Temp(F_FP());
     int i = targetLevel->levelIndex;
@@ -350,26 +364,61 @@ Tr_exp Tr_stringExp(string str) {
     string tlabel = Temp_labelstring(label);
     char buf[100];
     sprintf(buf, ".%s", tlabel);
-    printf("-----------------------------------------------------------%s\n", buf);
-    label = Temp_namedlabel(String(buf));
+    label = Temp_namedlabel(buf);
     F_frag strFrag = F_StringFrag(label, str);
     fragList = F_FragList(strFrag, fragList);
     return Tr_Ex(T_Name(label));
 }
 
 
+// Records and arrays are bumped out of [tiger_avail, tiger_limit) inline,
+// after the header word runtime.c reads: twice the size in bytes, header
+// included, plus 1 for an object to be scanned for pointers.  Only when
+// there is not room is allocRecord or initArray called.
+static T_exp Tr_heapWord(string name) {
+    return T_Mem(T_Name(Temp_namedlabel(name)));
+}
+
 Tr_exp Tr_arrayExp(Tr_exp size, Tr_exp value) {
     Temp_temp r = Temp_newtemp();
     Temp_temp s = Temp_newtemp(); 
     Temp_temp v = Temp_newtemp();               // init value
+    Temp_temp p = Temp_newtemp();               // the array's header
+    Temp_temp n = Temp_newtemp();               // its size in bytes
+    Temp_temp i = Temp_newtemp();               // the word to fill
+    Temp_label fits = Temp_newlabel(), fast = Temp_newlabel(), slow = Temp_newlabel();
+    Temp_label test = Temp_newlabel(), body = Temp_newlabel(), done = Temp_newlabel();
     
     T_stm getSize = T_Move(T_Temp(s), unEx(size));  // calculate size, put it into register s
     T_stm getInit = T_Move(T_Temp(v), unEx(value));  // calculate size, put it into register s
-    
+
+    // a negative or huge size goes to initArray, and n cannot overflow
+    T_stm check = T_Seq(T_Move(T_Temp(p), Tr_heapWord("tiger_avail")),
+                    T_Seq(T_Cjump(T_ugt, T_Temp(s), T_Const(0x0fffffff), slow, fits),
+                    T_Seq(T_Label(fits),
+                    T_Seq(T_Move(T_Temp(n), T_Binop(T_plus, T_Binop(T_mul, T_Temp(s), T_Const(F_wordSize)), T_Const(F_wordSize))),
+                        T_Cjump(T_ugt, T_Temp(n), T_Binop(T_minus, Tr_heapWord("tiger_limit"), T_Temp(p)), slow, fast)))));
+    T_stm call = T_Seq(T_Label(slow),
+                    T_Move(T_Temp(r), 
+                        F_externalCall("initArray", T_ExpList(T_Temp(s), T_ExpList(T_Temp(v), NULL)))));
+    T_stm fill = T_Seq(T_Label(fast),
+                    T_Seq(T_Move(T_Mem(T_Temp(p)), T_Binop(T_plus, T_Binop(T_mul, T_Temp(n), T_Const(2)), T_Const(1))),
+                    T_Seq(T_Move(T_Temp(r), T_Binop(T_plus, T_Temp(p), T_Const(F_wordSize))),
+                    T_Seq(T_Move(T_Temp(i), T_Temp(r)),
+                    T_Seq(T_Move(T_Temp(p), T_Binop(T_plus, T_Temp(p), T_Temp(n))),
+                    T_Seq(T_Move(Tr_heapWord("tiger_avail"), T_Temp(p)),
+                    T_Seq(T_Label(test),
+                    T_Seq(T_Cjump(T_uge, T_Temp(i), T_Temp(p), done, body),
+                    T_Seq(T_Label(body),
+                    T_Seq(T_Move(T_Mem(T_Temp(i)), T_Temp(v)),
+                    T_Seq(T_Move(T_Temp(i), T_Binop(T_plus, T_Temp(i), T_Const(F_wordSize))),
+                        T_Jump(T_Const(0), Temp_LabelList(test, NULL)))))))))))));
+
     T_stm alloc = T_Seq(getSize, 
                     T_Seq(getInit,
-                        T_Move(T_Temp(r), 
-                            F_externalCall("initArray", T_ExpList(T_Temp(s), T_ExpList(T_Temp(v), NULL))))));
+                    T_Seq(check,
+                    T_Seq(fill,
+                    T_Seq(call, T_Label(done))))));
 
     return Tr_Ex(T_Eseq(alloc, T_Temp(r)));
     // alloc space for array, register r is array address
@@ -411,8 +460,24 @@ Tr_exp Tr_commbineAllocInitReturn(Tr_exp alloc, Tr_exp init, Tr_exp r) {
     return Tr_Ex(T_Eseq(T_Seq(unNx(alloc), unNx(init)), unEx(r)));
 }
 
+// the fields are all stored next, so the fast path leaves them as they are
 Tr_exp Tr_allocMem(Tr_exp r, int size) {
-    T_stm alloc = T_Move(unEx(r), F_externalCall("allocRecord", T_ExpList(T_Const(size*F_wordSize), NULL)));
+    int n = (size + 1) * F_wordSize;
+    Temp_temp t = unEx(r)->u.TEMP;
+    Temp_temp p = Temp_newtemp();               // the record's header
+    Temp_temp q = Temp_newtemp();               // and its end
+    Temp_label fast = Temp_newlabel(), slow = Temp_newlabel(), done = Temp_newlabel();
+    T_stm alloc = T_Seq(T_Move(T_Temp(p), Tr_heapWord("tiger_avail")),
+                    T_Seq(T_Move(T_Temp(q), T_Binop(T_plus, T_Temp(p), T_Const(n))),
+                    T_Seq(T_Cjump(T_ugt, T_Temp(q), Tr_heapWord("tiger_limit"), slow, fast),
+                    T_Seq(T_Label(fast),
+                    T_Seq(T_Move(Tr_heapWord("tiger_avail"), T_Temp(q)),
+                    T_Seq(T_Move(T_Mem(T_Temp(p)), T_Const(2 * n + 1)),
+                    T_Seq(T_Move(T_Temp(t), T_Binop(T_plus, T_Temp(p), T_Const(F_wordSize))),
+                    T_Seq(T_Jump(T_Const(0), Temp_LabelList(done, NULL)),
+                    T_Seq(T_Label(slow),
+                    T_Seq(T_Move(T_Temp(t), F_externalCall("allocRecord", T_ExpList(T_Const(size*F_wordSize), NULL))),
+                        T_Label(done)))))))))));
     // T_stm alloc = T_Move(unEx(r), F_externalCall("tMalloc", T_ExpList(unEx(size), NULL)));
     return Tr_Nx(alloc);
 }
@@ -456,7 +521,6 @@ Tr_exp Tr_LoopExp(Tr_exp condition, Tr_exp body, Temp_label done) {
 
 
 Tr_exp Tr_callExp(Temp_label name, Tr_level currentLevel, Tr_level funcLevel, T_expList formals) {
-    printf("------------------------------------%s - current:%d   funcLevel:%d\n", S_name(name), currentLevel->levelIndex, funcLevel->levelIndex);
     T_exp staticLink = T_Temp(F_FP());
     if(currentLevel->levelIndex >= funcLevel->levelIndex) {
         int index = currentLevel->levelIndex;
@@ -57,10 +57,17 @@ Tr_exp Tr_nilExp();
 void Tr_procEntryExit(Tr_level level, Tr_exp body, Tr_accessList formals);
 F_fragList Tr_getResult();
 
+/* Start translating a new program: no fragments yet, and a fresh frame
+ * for the outermost level (which itself is kept, since the base
+ * environment refers to it) */
+void Tr_newProgram(void);
 Tr_level Tr_outermost();
 Tr_level Tr_newLevel(Tr_level parent, Temp_label name, U_boolList formals);
 
 Tr_accessList Tr_formals(Tr_level level);
 Tr_access Tr_allocLocal(Tr_level level, bool escape);
 
+/* the variable at "access" is an int, never a heap pointer (see F_gc) */
+void Tr_markScalar(Tr_access access);
+
 #endif
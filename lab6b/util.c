@@ -5,8 +5,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "util.h"
-void *checked_malloc(int len)
+
+static void *raw_malloc(size_t len)
 {void *p = malloc(len);
  if (!p) {
     fprintf(stderr,"\nRan out of memory!\n");
@@ -15,6 +17,11 @@ void *checked_malloc(int len)
  return p;
 }
 
+void *checked_malloc(int len)
+{
+ return U_regionAlloc(U_regionSwitch(NULL), len);
+}
+
 string createString(string format, int i) {
     char buf[100];
     sprintf(buf, format, i);
@@ -33,3 +40,139 @@ U_boolList U_BoolList(bool head, U_boolList tail)
   list->tail = tail;
   return list;
 }
+
+
+
+/* Regions */
+
+#define CHUNKSIZE (64*1024)
+#define ALIGN 8
+
+typedef struct chunk_ *chunk;
+struct chunk_ {chunk next; size_t size;};
+
+struct U_region_ {
+  string name;
+  chunk chunks;            /* most recent first */
+  char *avail, *limit;     /* free space in chunks->head */
+  size_t used, peak;       /* bytes handed out, and the most ever at once */
+  size_t reserved, peakReserved;
+  long allocs, resets;
+  bool shared;             /* allocated from by every thread */
+  U_region next;           /* all regions, for U_regionReport */
+};
+
+/* Each thread has its own current region; the permanent one is shared,
+ * so allocating from it, like making a region, takes a lock. */
+static U_region regions = NULL;
+static __thread U_region current = NULL;
+static __thread size_t allocated = 0;   /* by this thread, ever */
+static pthread_mutex_t regionLock = PTHREAD_MUTEX_INITIALIZER;
+
+U_region U_Region(string name)
+{U_region r = raw_malloc(sizeof(*r)), *p;
+ r->name = name;
+ r->shared = FALSE;
+ r->chunks = NULL;
+ r->avail = r->limit = NULL;
+ r->used = r->peak = 0;
+ r->reserved = r->peakReserved = 0;
+ r->allocs = r->resets = 0;
+ r->next = NULL;
+ pthread_mutex_lock(&regionLock);
+ for (p = &regions; *p; p = &(*p)->next) ;
+ *p = r;
+ pthread_mutex_unlock(&regionLock);
+ return r;
+}
+
+U_region U_permanent(void)
+{static U_region perm = NULL;
+ if (!perm) {
+   perm = U_Region("permanent");
+   perm->shared = TRUE;
+ }
+ return perm;
+}
+
+U_region U_regionSwitch(U_region r)
+{U_region prev = current ? current : U_permanent();
+ if (r) current = r;
+ return prev;
+}
+
+/* Chain a fresh chunk with at least "len" free bytes in front of r's chunks.
+ * Requests larger than a quarter chunk get a chunk of their own, placed
+ * behind the current one so its free space is not thrown away. */
+static char *newChunk(U_region r, size_t len)
+{size_t size = len > CHUNKSIZE/4 ? len : CHUNKSIZE;
+ chunk c = raw_malloc(sizeof(struct chunk_) + size);
+ char *data = (char *)c + ((sizeof(struct chunk_) + ALIGN-1) & ~(size_t)(ALIGN-1));
+ c->size = size;
+ r->reserved += size;
+ if (r->reserved > r->peakReserved) r->peakReserved = r->reserved;
+ if (size != CHUNKSIZE && r->chunks) {
+   c->next = r->chunks->next;
+   r->chunks->next = c;
+   return data;
+ }
+ c->next = r->chunks;
+ r->chunks = c;
+ r->avail = data + len;
+ r->limit = data + size;
+ return data;
+}
+
+void *U_regionAlloc(U_region r, int len)
+{char *p;
+ size_t n = ((size_t)(len > 0 ? len : 1) + ALIGN-1) & ~(size_t)(ALIGN-1);
+ assert(r && len >= 0);
+ if (r->shared) pthread_mutex_lock(&regionLock);
+ r->allocs++;
+ r->used += n;
+ allocated += n;
+ if (r->used > r->peak) r->peak = r->used;
+ if (n <= (size_t)(r->limit - r->avail)) {
+   p = r->avail;
+   r->avail += n;
+ }
+ else p = newChunk(r, n);
+ if (r->shared) pthread_mutex_unlock(&regionLock);
+ return p;
+}
+
+void U_regionReset(U_region r)
+{chunk c, keep = NULL;
+ assert(r && r != U_permanent());
+ while (r->chunks) {
+   c = r->chunks;
+   r->chunks = c->next;
+   if (!keep && c->size == CHUNKSIZE) keep = c;
+   else free(c);
+ }
+ r->resets++;
+ r->used = 0;
+ r->avail = r->limit = NULL;
+ r->reserved = 0;
+ if (keep) {
+   keep->next = NULL;
+   r->chunks = keep;
+   r->avail = (char *)keep + ((sizeof(struct chunk_) + ALIGN-1) & ~(size_t)(ALIGN-1));
+   r->limit = r->avail + keep->size;
+   r->reserved = keep->size;
+ }
+}
+
+void U_regionReport(FILE *out)
+{U_region r;
+ fprintf(out, "%-12s %12s %12s %10s %8s\n",
+         "region", "peak KB", "reserved KB", "allocs", "resets");
+ for (r = regions; r; r = r->next)
+   fprintf(out, "%-12s %12.1f %12.1f %10ld %8ld\n", r->name,
+           r->peak/1024.0, r->peakReserved/1024.0, r->allocs, r->resets);
+}
+
+size_t U_allocated(void)
+{
+ return allocated;
+}
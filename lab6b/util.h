@@ -1,6 +1,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 #include <assert.h>
+#include <stdio.h>
 
 typedef char *string;
 typedef char bool;
@@ -17,4 +18,38 @@ string createString(string format, int i);
 typedef struct U_boolList_ *U_boolList;
 struct U_boolList_ {bool head; U_boolList tail;};
 U_boolList U_BoolList(bool head, U_boolList tail);
+
+
+/*
+ * Regions: bump-pointer arenas that are released wholesale.
+ *  checked_malloc (and so String, createString and every constructor
+ *  built on it) carves from the current region.  Data that must outlive
+ *  a phase (symbols, temps, the frame's register tables) is allocated
+ *  in the permanent region, which is never reset.
+ *  The current region is per thread.  Only the permanent region may be
+ *  allocated from by several threads at once.
+ */
+typedef struct U_region_ *U_region;
+
+/* Make a new, empty region; "name" is used by U_regionReport */
+U_region U_Region(string name);
+
+/* The region that is never reset */
+U_region U_permanent(void);
+
+/* Make "r" the current region and return the previously current one;
+ *  U_regionSwitch(NULL) just returns the current region. */
+U_region U_regionSwitch(U_region r);
+
+/* Allocate "len" bytes from "r" */
+void *U_regionAlloc(U_region r, int len);
+
+/* Drop everything allocated in "r", keeping one chunk for reuse */
+void U_regionReset(U_region r);
+
+/* Print the high-water mark of every region made so far */
+void U_regionReport(FILE *out);
+
+/* Total bytes this thread has allocated from every region */
+size_t U_allocated(void);
 #endif
@@ -0,0 +1,391 @@
+/*
+ * x86encode.c - i386 machine code for the instructions codegen makes, and
+ *               its x86-64 variant for running in process.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "symbol.h"
+#include "table.h"
+#include "temp.h"
+#include "assem.h"
+#include "errormsg.h"
+#include "encode.h"
+
+/* in the order of their numbers in ModRM bytes */
+static string registers[8] = {
+  "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi"
+};
+
+/* an operand with its temps named */
+struct operand {
+  enum {REG, MEM, IMM, SYM} kind;
+  int reg;              /* REG; MEM's base, or -1 for an absolute address */
+  int value;            /* IMM; MEM's displacement */
+  Temp_label sym;       /* IMM: add sym's address; SYM: a call or jump target */
+};
+
+static Temp_temp nth(Temp_tempList l, int i)
+{
+ for (; l && i > 0; i--) l = l->tail;
+ return l ? l->head : NULL;
+}
+
+/* the register named "t", or -1 with *sym set if it names a label */
+static int reg(Temp_temp t, Temp_map m, Temp_label *sym)
+{string name;
+ int i;
+ *sym = NULL;
+ if (!t || !(name = Temp_look(m, t))) return -1;
+ for (i = 0; i < 8; i++)
+   if (!strcmp(name, registers[i])) return i;
+ if (name[0] != '%' && (name[0] < '0' || name[0] > '9'))
+   *sym = Temp_namedlabel(name);
+ return -1;
+}
+
+static bool operand(struct operand *o, AS_operand *a, AS_instr i, Temp_map m)
+{Temp_tempList src = i->u.OPER.src, dst = i->u.OPER.dst;
+ Temp_labelList l;
+ int n;
+ o->sym = NULL;
+ o->value = 0;
+ switch (a->kind) {
+ case AS_IMM:
+   o->kind = IMM;
+   o->value = a->u.value;
+   return TRUE;
+ case AS_TEMP:
+   o->kind = REG;
+   o->reg = reg(nth(a->dst ? dst : src, a->index), m, &o->sym);
+   return o->reg >= 0;
+ case AS_ADDR:
+   o->kind = IMM;
+   reg(nth(src, a->index), m, &o->sym);
+   return o->sym != NULL;
+ case AS_DISP:
+   o->value = a->u.value;
+   /* fall through */
+ case AS_IND:
+   o->kind = MEM;
+   o->reg = reg(nth(src, a->index), m, &o->sym);
+   return o->reg >= 0;
+ case AS_ABS:
+   o->kind = MEM;
+   o->reg = -1;
+   o->value = a->u.value;
+   return TRUE;
+ case AS_TARGET:
+   if (!i->u.OPER.jumps) return FALSE;
+   for (l = i->u.OPER.jumps->labels, n = a->index; l && n > 0; n--) l = l->tail;
+   if (!l) return FALSE;
+   o->kind = SYM;
+   o->sym = l->head;
+   return TRUE;
+ case AS_NAME:
+   /* a call's target, or else the word at the label */
+   o->kind = i->u.OPER.code.op == AS_CALL ? SYM : MEM;
+   o->reg = -1;
+   o->sym = a->u.label;
+   return TRUE;
+ default:
+   return FALSE;
+ }
+}
+
+/* where each of the procedure's labels is, and the jumps to them */
+struct fixup {int at; Temp_label label; struct fixup *next;};
+
+struct state {
+  EN_target target;
+  AS_buffer code, relocs;
+  size_t start;         /* of this procedure in code */
+  TAB_table labels;     /* label -> int *, its offset */
+  struct fixup *fixups;
+};
+
+static void byte(struct state *s, int v)
+{
+ *AS_reserve(s->code, 1) = (char)v;
+ s->code->length++;
+}
+
+static void word(struct state *s, int v)
+{unsigned char *p = (unsigned char *)AS_reserve(s->code, 4);
+ p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+ s->code->length += 4;
+}
+
+static bool fits8(int v) {return v >= -128 && v <= 127;}
+
+/* the 4 bytes at the current end, holding "addend", are relocated */
+static void reloc(struct state *s, Temp_label sym, bool pcRelative, int addend)
+{EN_reloc r;
+ r.offset = s->code->length - s->start;
+ r.pcRelative = pcRelative;
+ r.sym = sym;
+ AS_write(s->relocs, (char *)&r, sizeof(r));
+ word(s, addend);
+}
+
+static void imm32(struct state *s, struct operand *o)
+{
+ if (o->sym) reloc(s, o->sym, FALSE, o->value);
+ else word(s, o->value);
+}
+
+/* ModRM (and SIB and displacement) for "r" with the register or memory
+ * operand "o" */
+static void modrm(struct state *s, int r, struct operand *o)
+{int mod;
+ if (o->kind == REG) {
+   byte(s, 0xC0 | r << 3 | o->reg);
+   return;
+ }
+ if (o->reg < 0) {
+   /* x86-64 reads mod 0, r/m 5 as %rip-relative; a SIB byte with
+    * neither base nor index is absolute */
+   if (s->target == EN_LOW64) {
+     byte(s, 0x04 | r << 3);
+     byte(s, 0x25);
+   } else
+     byte(s, 0x05 | r << 3);
+   imm32(s, o);
+   return;
+ }
+ /* (%ebp) has no mod 0 form: that is an absolute address */
+ mod = o->value == 0 && o->reg != 5 ? 0 : fits8(o->value) ? 1 : 2;
+ byte(s, mod << 6 | r << 3 | o->reg);
+ if (o->reg == 4) byte(s, 0x24);       /* SIB: no index, base %esp */
+ if (mod == 1) byte(s, o->value);
+ else if (mod == 2) word(s, o->value);
+}
+
+static void jump(struct state *s, Temp_label target)
+{int *at = TAB_look(s->labels, target);
+ struct fixup *f;
+ if (at) {
+   /* backward: the label is known */
+   word(s, *at - (int)(s->code->length - s->start + 4));
+   return;
+ }
+ f = checked_malloc(sizeof(*f));
+ f->at = s->code->length - s->start;
+ f->label = target;
+ f->next = s->fixups;
+ s->fixups = f;
+ word(s, 0);
+}
+
+/* add, sub and cmp: "n" is both the /digit and the high bits of the
+ * opcode */
+static bool arith(struct state *s, int n, struct operand *src, struct operand *dst)
+{
+ if (dst->kind != REG && dst->kind != MEM) return FALSE;
+ if (src->kind == IMM) {
+   if (!src->sym && fits8(src->value)) {
+     byte(s, 0x83); modrm(s, n, dst); byte(s, src->value);
+   } else {
+     byte(s, 0x81); modrm(s, n, dst); imm32(s, src);
+   }
+ } else if (src->kind == REG) {
+   byte(s, n << 3 | 0x01); modrm(s, src->reg, dst);
+ } else if (src->kind == MEM && dst->kind == REG) {
+   byte(s, n << 3 | 0x03); modrm(s, dst->reg, src);
+ } else
+   return FALSE;
+ return TRUE;
+}
+
+/* Pieces of the EN_LOW64 forms of push, call, leave and ret: addresses
+ * are 32 bits, hence the 0x67 prefixes */
+static void moveESP(struct state *s, int by)    /* lea by(%esp), %esp */
+{
+ byte(s, 0x67); byte(s, 0x8D); byte(s, 0x64); byte(s, 0x24); byte(s, by);
+}
+
+static void storeTop(struct state *s, int r)    /* movl r, (%esp) */
+{
+ byte(s, 0x67); byte(s, 0x89); byte(s, 0x04 | r << 3); byte(s, 0x24);
+}
+
+static void storeTopImm(struct state *s)        /* movl $imm32, (%esp) */
+{
+ byte(s, 0x67); byte(s, 0xC7); byte(s, 0x04); byte(s, 0x24);
+}
+
+static void loadTop(struct state *s, int r)     /* movl (%esp), r */
+{
+ byte(s, 0x67); byte(s, 0x8B); byte(s, 0x04 | r << 3); byte(s, 0x24);
+}
+
+static bool push64(struct state *s, struct operand *src)
+{
+ if (src->kind != REG && src->kind != IMM) return FALSE;
+ moveESP(s, -4);
+ if (src->kind == REG)
+   storeTop(s, src->reg);
+ else {
+   storeTopImm(s);
+   imm32(s, src);
+ }
+ return TRUE;
+}
+
+static bool encode(struct state *s, AS_instr i, Temp_map m)
+{struct operand src, dst;
+ AS_code *c;
+ int *at;
+ switch (i->kind) {
+ case I_LABEL:
+   at = checked_malloc(sizeof(*at));
+   *at = s->code->length - s->start;
+   TAB_enter(s->labels, i->u.LABEL.label, at);
+   return TRUE;
+ case I_MOVE:
+   src.reg = reg(i->u.MOVE.src->head, m, &src.sym);
+   dst.reg = reg(i->u.MOVE.dst->head, m, &dst.sym);
+   if (src.reg < 0 || dst.reg < 0) return FALSE;
+   byte(s, 0x89); byte(s, 0xC0 | src.reg << 3 | dst.reg);
+   return TRUE;
+ case I_OPER:
+   break;
+ }
+ c = &i->u.OPER.code;
+ src.kind = dst.kind = -1;
+ if (c->src.kind != AS_NONE && !operand(&src, &c->src, i, m)) return FALSE;
+ if (c->dst.kind != AS_NONE && !operand(&dst, &c->dst, i, m)) return FALSE;
+ if (s->target == EN_LOW64) {
+   switch (c->op) {
+   case AS_PUSHL:
+     return push64(s, &src);
+   case AS_CALL:
+     /* push where the jmp returns to, then jmp */
+     if (src.kind != SYM) return FALSE;
+     moveESP(s, -4);
+     storeTopImm(s);
+     reloc(s, NULL, FALSE, s->code->length - s->start + 4 + 5);
+     byte(s, 0xE9);
+     reloc(s, src.sym, TRUE, -4);
+     return TRUE;
+   case AS_LEAVE:
+     byte(s, 0x89); byte(s, 0xEC);              /* movl %ebp, %esp */
+     loadTop(s, 5);                             /* movl (%esp), %ebp */
+     moveESP(s, 4);
+     return TRUE;
+   case AS_RET:
+     loadTop(s, 1);                             /* movl (%esp), %ecx */
+     moveESP(s, 4);
+     byte(s, 0xFF); byte(s, 0xE1);              /* jmp *%rcx */
+     return TRUE;
+   default:
+     if (src.kind == MEM || dst.kind == MEM) byte(s, 0x67);
+     break;
+   }
+ }
+ switch (c->op) {
+ case AS_NOP:
+   return TRUE;
+ case AS_MOVL:
+   if (src.kind == IMM && dst.kind == REG) {
+     byte(s, 0xB8 + dst.reg); imm32(s, &src);
+   } else if (src.kind == IMM && dst.kind == MEM) {
+     byte(s, 0xC7); modrm(s, 0, &dst); imm32(s, &src);
+   } else if (src.kind == REG && (dst.kind == REG || dst.kind == MEM)) {
+     byte(s, 0x89); modrm(s, src.reg, &dst);
+   } else if (src.kind == MEM && dst.kind == REG) {
+     byte(s, 0x8B); modrm(s, dst.reg, &src);
+   } else
+     return FALSE;
+   return TRUE;
+ case AS_ADDL: return arith(s, 0, &src, &dst);
+ case AS_SUBL: return arith(s, 5, &src, &dst);
+ case AS_CMP: return arith(s, 7, &src, &dst);
+ case AS_IMULL:
+   if (dst.kind != REG) return FALSE;
+   if (src.kind == IMM && !src.sym && fits8(src.value)) {
+     byte(s, 0x6B); modrm(s, dst.reg, &dst); byte(s, src.value);
+   } else if (src.kind == IMM) {
+     byte(s, 0x69); modrm(s, dst.reg, &dst); imm32(s, &src);
+   } else if (src.kind == REG || src.kind == MEM) {
+     byte(s, 0x0F); byte(s, 0xAF); modrm(s, dst.reg, &src);
+   } else
+     return FALSE;
+   return TRUE;
+ case AS_IDIVL:
+   if (src.kind != REG && src.kind != MEM) return FALSE;
+   byte(s, 0xF7); modrm(s, 7, &src);
+   return TRUE;
+ case AS_CLTD: byte(s, 0x99); return TRUE;
+ case AS_LEAVE: byte(s, 0xC9); return TRUE;
+ case AS_RET: byte(s, 0xC3); return TRUE;
+ case AS_PUSHL:
+   if (src.kind == REG)
+     byte(s, 0x50 + src.reg);
+   else if (src.kind == IMM && !src.sym && fits8(src.value)) {
+     byte(s, 0x6A); byte(s, src.value);
+   } else if (src.kind == IMM) {
+     byte(s, 0x68); imm32(s, &src);
+   } else if (src.kind == MEM) {
+     byte(s, 0xFF); modrm(s, 6, &src);
+   } else
+     return FALSE;
+   return TRUE;
+ case AS_CALL:
+   if (src.kind != SYM) return FALSE;
+   byte(s, 0xE8);
+   reloc(s, src.sym, TRUE, -4);
+   return TRUE;
+ case AS_JMP:
+   if (src.kind != SYM) return FALSE;
+   byte(s, 0xE9);
+   jump(s, src.sym);
+   return TRUE;
+ case AS_JE: case AS_JNE: case AS_JL: case AS_JG: case AS_JLE: case AS_JGE:
+ case AS_JB: case AS_JA: case AS_JBE: case AS_JAE: {
+   static int cc[] = {0x4, 0x5, 0xC, 0xF, 0xE, 0xD, 0x2, 0x7, 0x6, 0x3};
+   if (src.kind != SYM) return FALSE;
+   byte(s, 0x0F); byte(s, 0x80 | cc[c->op - AS_JE]);
+   jump(s, src.sym);
+   return TRUE;
+ }
+ default:
+   return FALSE;
+ }
+}
+
+bool EN_encode(AS_buffer code, AS_buffer relocs, AS_instrList body, Temp_map m,
+               EN_target target)
+{struct state s;
+ struct fixup *f;
+ int n;
+ s.target = target;
+ s.code = code;
+ s.relocs = relocs;
+ s.start = code->length;
+ s.labels = TAB_empty();
+ s.fixups = NULL;
+ for (n = 0; body; body = body->tail, n++)
+   if (!encode(&s, body->head, m)) {
+     EM_error(0, "cannot encode instruction %d of a function", n);
+     return FALSE;
+   }
+ for (f = s.fixups; f; f = f->next) {
+   int *at = TAB_look(s.labels, f->label);
+   unsigned char *p = (unsigned char *)code->text + s.start + f->at;
+   int rel;
+   if (!at) {
+     /* not this procedure's: leave it to the linker */
+     EN_reloc r;
+     r.offset = f->at;
+     r.pcRelative = TRUE;
+     r.sym = f->label;
+     AS_write(relocs, (char *)&r, sizeof(r));
+     rel = -4;
+   } else
+     rel = *at - (f->at + 4);
+   p[0] = rel; p[1] = rel >> 8; p[2] = rel >> 16; p[3] = rel >> 24;
+ }
+ return TRUE;
+}
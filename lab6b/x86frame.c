@@ -11,6 +11,10 @@
 /*Lab5: Your implementation here.*/
 const int F_wordSize = 4;
 
+bool F_gc = FALSE;
+
+__thread Temp_map F_tempMap;
+
 static F_access InFrame(int offset);
 static F_access InReg(Temp_temp reg);
 
@@ -18,6 +22,7 @@ struct F_frame_ {
     int sp;
     F_accessList accessList;
     Temp_label label;
+    F_accessList scalars;   // slots the front end knows hold no pointer
 };
 
 struct F_access_ {
@@ -114,6 +119,7 @@ Temp_temp F_DivLOW() {
 Temp_tempList F_registers() {
     static Temp_tempList registers = NULL;
     if(registers == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
         registers = Temp_TempList(F_EAX(),
                     Temp_TempList(F_EBX(),
                     Temp_TempList(F_ECX(),
@@ -122,13 +128,15 @@ Temp_tempList F_registers() {
                     Temp_TempList(F_EDI(), NULL))))));
         // Temp_TempList(F_ESP(),
         //             Temp_TempList(F_EBP()
+        U_regionSwitch(prev);
     }
     return registers;
 }
 
-Temp_map F_preColored() {
+static Temp_map preColored() {
     static Temp_map t = NULL;
     if(t == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
         t = Temp_empty();
         Temp_enter(t, F_EAX(), "%eax");
         Temp_enter(t, F_EBX(), "%ebx");
@@ -138,16 +146,23 @@ Temp_map F_preColored() {
         Temp_enter(t, F_EDI(), "%edi");
         Temp_enter(t, F_ESP(), "%esp");
         Temp_enter(t, F_EBP(), "%ebp");
+        U_regionSwitch(prev);
     }
-    return Temp_layerMap(F_tempMap, t);
+    return t;
+}
+
+Temp_map F_preColored() {
+    return Temp_layerMap(F_tempMap, preColored());
 }
 
 Temp_tempList F_calleeSaves() {
     static Temp_tempList t = NULL;
     if(t == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
         t = Temp_TempList(F_EBX(),
             Temp_TempList(F_ESI(),
             Temp_TempList(F_EDI(), NULL)));
+        U_regionSwitch(prev);
     }
     return t;
 }
@@ -155,9 +170,11 @@ Temp_tempList F_calleeSaves() {
 Temp_tempList F_callerSaves() {
     static Temp_tempList t = NULL;
     if(t == NULL) {
+        U_region prev = U_regionSwitch(U_permanent());
         t = Temp_TempList(F_EAX(),
             Temp_TempList(F_EDX(),
             Temp_TempList(F_ECX(),NULL)));
+        U_regionSwitch(prev);
     }
     return t;   
 }
@@ -172,10 +189,10 @@ T_exp F_Exp(F_access acc, T_exp framePtr) {
 }
 
 F_frame F_newFrame(Temp_label name, U_boolList formals) {
-    printf("new frame------------------------------------\n");
     F_frame p = checked_malloc(sizeof(*p));
-    p->sp = 0;
+    p->sp = F_gc ? -1 : 0;    // -fgc: -4(%ebp) holds the frame's map
     p->label = name;
+    p->scalars = NULL;
     F_accessList accessList = NULL;
     U_boolList boolList = formals;
     F_accessList tail = NULL, tAccessList;
@@ -211,11 +228,38 @@ F_access F_allocLocal(F_frame f, bool escape) {
     return access;
 }
 
+void F_markScalar(F_frame f, F_access access) {
+    if(access->kind == inFrame)
+        f->scalars = F_AccessList(access, f->scalars);
+}
+
+static bool isScalar(F_frame f, int offset) {
+    F_accessList l;
+    for(l = f->scalars; l; l = l->tail)
+        if(l->head->u.offset == offset)
+            return TRUE;
+    return FALSE;
+}
+
+// the runtime functions that allocate, and so may collect; those that
+// read a string's characters may have to put a concat together first
+bool F_allocates(Temp_label fun) {
+    string s = S_name(fun);
+    return !strcmp(s, "allocRecord") || !strcmp(s, "initArray")
+        || !strcmp(s, "concat") || !strcmp(s, "substring")
+        || !strcmp(s, "print") || !strcmp(s, "ord") || !strcmp(s, "stringEqual");
+}
+
 int F_accessOffset(F_access access) {
     assert(access->kind == inFrame);
     return access->u.offset;
 }
 
+/* the offset of the last local allocated, in F_accessOffset's units */
+int F_frameMaxOffset(F_frame f) {
+    return f->sp;
+}
+
 Temp_label F_name(F_frame f) {
     return f->label;
 }
@@ -291,33 +335,91 @@ T_stm F_procEntryExit1(F_frame frame, T_stm stm) {
 }
 
 
-AS_instrList F_procEntryExit2(AS_instrList body) {
-    static Temp_tempList returnSink = NULL;
-    if(!returnSink) {
-        returnSink = Temp_TempList(F_RV(),
-                     Temp_TempList(F_FP(),
-                     Temp_TempList(F_SP(), NULL)));
-                     // Temp_TempList(F_SP(), F_calleeSaves())));
+static Temp_tempList returnSink() {
+    static Temp_tempList t = NULL;
+    if(!t) {
+        U_region prev = U_regionSwitch(U_permanent());
+        t = Temp_TempList(F_RV(),
+            Temp_TempList(F_FP(),
+            Temp_TempList(F_SP(), NULL)));
+            // Temp_TempList(F_SP(), F_calleeSaves())));
+        U_regionSwitch(prev);
     }
+    return t;
+}
+
+AS_instrList F_procEntryExit2(AS_instrList body) {
     return AS_splice(body, AS_InstrList(
-                    AS_Oper("", NULL, returnSink, NULL), NULL));
+                    AS_Oper(AS_Code(AS_NOP, AS_None(), AS_None()), NULL, returnSink(), NULL), NULL));
+}
+
+// the tables above are built on first use; build them all now, while
+// only one thread runs
+void F_init(void) {
+    F_registers();
+    preColored();
+    F_calleeSaves();
+    F_callerSaves();
+    returnSink();
 }
  
 
+/* -fgc: the map of "frame", in runtime.c's struct tiger_map: whether it
+ * is the outermost frame, the number of slots, and their offsets from
+ * %ebp.  The formals (the static link aside) and every local but the map
+ * itself, spills included, are in it unless they are scalars. */
+string F_frameMap(F_frame frame) {
+    string name = S_name(frame->label);
+    F_accessList l;
+    int i, n = 0, o;
+    string s;
+    char *p;
+
+    for(l = frame->accessList; l; l = l->tail)
+        if(l->head->kind == inFrame && !isScalar(frame, l->head->u.offset))
+            n++;
+    for(o = -2; o >= frame->sp; o--)
+        if(!isScalar(frame, o))
+            n++;
+    p = s = checked_malloc(96 + 2 * strlen(name) + 16 * n);
+    p += sprintf(p, "\n.section .rodata\n.align 4\n%s.map:\n.long %d, %d",
+                 name, frame->label == Temp_namedlabel("tigermain"), n);
+    for(i = 0, l = frame->accessList; l; l = l->tail)
+        if(l->head->kind == inFrame && !isScalar(frame, l->head->u.offset))
+            p += sprintf(p, "%s%d", i++ % 16 ? ", " : "\n.long ", l->head->u.offset * F_wordSize);
+    for(o = -2; o >= frame->sp; o--)
+        if(!isScalar(frame, o))
+            p += sprintf(p, "%s%d", i++ % 16 ? ", " : "\n.long ", o * F_wordSize);
+    sprintf(p, "\n.text\n");
+    return s;
+}
+
+// movl $name.map, -4(%ebp)
+static AS_instr storeMap(F_frame frame) {
+    Temp_temp map = Temp_newtemp();
+    char buf[256];
+    sprintf(buf, "%.200s.map", S_name(frame->label));
+    Temp_enter(F_tempMap, map, String(buf));
+    return AS_Oper(AS_Code(AS_MOVL, AS_Addr(0), AS_Disp(-F_wordSize, 1)), NULL,
+                   Temp_TempList(map, Temp_TempList(F_FP(), NULL)), NULL);
+}
+
 // indication
 AS_proc F_procEntryExit3(F_frame frame, AS_instrList body) {
     char buf[1024];
     sprintf(buf, ".text\n.globl %s\n.type %s, @function\n %s:", 
                 S_name(frame->label), S_name(frame->label), S_name(frame->label));
-    AS_instr pushEBP = AS_Oper("pushl `s0\n", NULL, Temp_TempList(F_FP(), NULL), NULL);
-    AS_instr moveESP = AS_Oper("movl `s0, `d0\n", Temp_TempList(F_FP(), NULL), Temp_TempList(F_SP(), NULL), NULL);
-    AS_instr minusESP = AS_Oper(createString("addl $%d, `d0\n", (frame->sp - 3)*F_wordSize), 
+    AS_instr pushEBP = AS_Oper(AS_Code(AS_PUSHL, AS_Src(0), AS_None()), NULL, Temp_TempList(F_FP(), NULL), NULL);
+    AS_instr moveESP = AS_Oper(AS_Code(AS_MOVL, AS_Src(0), AS_Dst(0)), Temp_TempList(F_FP(), NULL), Temp_TempList(F_SP(), NULL), NULL);
+    AS_instr minusESP = AS_Oper(AS_Code(AS_ADDL, AS_Imm((frame->sp - 3)*F_wordSize), AS_Dst(0)), 
                             Temp_TempList(F_SP(), NULL), NULL, NULL);
-    AS_instr leave = AS_Oper("leave\n", NULL, NULL, NULL);
-    AS_instr ret = AS_Oper("ret\n", NULL, NULL, NULL);
+    AS_instr leave = AS_Oper(AS_Code(AS_LEAVE, AS_None(), AS_None()), NULL, NULL, NULL);
+    AS_instr ret = AS_Oper(AS_Code(AS_RET, AS_None(), AS_None()), NULL, NULL, NULL);
+    if(F_gc)
+        body = AS_InstrList(storeMap(frame), body);
     body = AS_splice(AS_InstrList(pushEBP, AS_InstrList(moveESP, AS_InstrList(minusESP, NULL))), body);
     body = AS_splice(body, AS_InstrList(leave, AS_InstrList(ret, NULL)));
-    return AS_Proc(String(buf), body, String("\n"));
+    return AS_Proc(String(buf), body, F_gc ? F_frameMap(frame) : String("\n"));
 }
 
 
@@ -326,14 +428,12 @@ T_exp F_externalCall(string s, T_expList args) {
 }
 
 
-void F_string(FILE *fp, F_frag frag) {
-    char buf[200];
-    fprintf(fp, "%s: .ascii \"", S_name(frag->u.stringg.label));
-
-    int i = 0;
-    int tSize = strlen(frag->u.stringg.str);
+/* label: .ascii "<length as 4 bytes, little endian><the string>" */
+void F_string(AS_buffer out, F_frag frag) {
     string str = frag->u.stringg.str;
-    int size = 0;
+    int i, tSize = strlen(str), size = 0;
+    char *p;
+
     for(i = 0; i < tSize; ++i) {
         if(str[i] == '\\') {
             if(str[i+1] == 'n' || str[i+1] == 't' || str[i+1] == '0' || str[i+1] == '\\') {
@@ -342,9 +442,39 @@ void F_string(FILE *fp, F_frag frag) {
         }
         size += 1;
     }
-    
+
+    AS_puts(out, S_name(frag->u.stringg.label));
+    AS_puts(out, ": .ascii \"");
+    p = AS_reserve(out, 4);
+    for(i = 0; i < 4; ++i) {
+        p[i] = (char)((size >> (i * 8)) & 0xff);
+    }
+    out->length += 4;
+    AS_write(out, str, tSize);
+    AS_puts(out, "\"\n");
+}
+
+/* the same string as it is in memory: its length, then its characters
+ * with the escapes .ascii would expand */
+void F_stringData(AS_buffer out, F_frag frag) {
+    string str = frag->u.stringg.str;
+    int i, tSize = strlen(str), size = 0;
+    char *p = AS_reserve(out, 4 + tSize);
+
+    for(i = 0; i < tSize; ++i) {
+        char c = str[i];
+        if(c == '\\') {
+            switch(str[i+1]) {
+                case 'n': c = '\n'; i++; break;
+                case 't': c = '\t'; i++; break;
+                case '0': c = '\0'; i++; break;
+                case '\\': i++; break;
+            }
+        }
+        p[4 + size++] = c;
+    }
     for(i = 0; i < 4; ++i) {
-        fprintf(fp, "%c", (char)( (size >> (i * 8)) & 0xff));
+        p[i] = (char)((size >> (i * 8)) & 0xff);
     }
-    fprintf(fp, "%s\"\n", frag->u.stringg.str);
+    out->length += 4 + size;
 }